@@ -0,0 +1,105 @@
+/*Snake Game - Asset Cache
+2023.12
+按路径缓存解析后的地图、配置等文件，记录文件的大小和修改时间
+再次读取时只查询一次文件状态，文件没有改动就直接返回内存中的结果，改动或删除后重新读取
+*/
+
+#ifndef SNAKE_ASSETCACHE_H
+#define SNAKE_ASSETCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+// 文件状态：是否存在、大小和修改时间（纳秒或 100 纳秒为单位，只用于比较）
+struct FileStamp
+{
+    bool exists;
+    uint64_t size;
+    int64_t time;
+
+    bool operator==(const FileStamp &other) const
+    {
+        return exists == other.exists && size == other.size && time == other.time;
+    }
+};
+
+// 查询文件状态，一次系统调用同时取得大小和修改时间，不存在或不是普通文件时 exists 为 false
+inline FileStamp GetFileStamp(const string &path)
+{
+    FileStamp stamp = {false, 0, 0};
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        return stamp;
+    }
+    stamp.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    stamp.time = static_cast<int64_t>((static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+#else
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return stamp;
+    }
+    stamp.size = status.st_size;
+    stamp.time = static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+    stamp.exists = true;
+    return stamp;
+}
+
+// 解析结果缓存，Load 的形式为 bool(const string &path, T &value)
+template <class T>
+class AssetCache
+{
+private:
+    struct Entry
+    {
+        FileStamp stamp;
+        T value;
+    };
+    unordered_map<string, Entry> entries;
+
+public:
+    // 读取 path 到 value，文件没有改动时直接复制缓存的结果，否则调用 load 重新解析
+    // 文件不存在或解析失败时返回 false，并丢弃该路径的缓存
+    template <class Load>
+    bool Get(const string &path, T &value, Load load)
+    {
+        // 状态在解析之前查询，解析期间文件被改写时下次读取会看到新的状态并重新解析
+        FileStamp stamp = GetFileStamp(path);
+        auto found = entries.find(path);
+        if (stamp.exists && found != entries.end() && found->second.stamp == stamp)
+        {
+            value = found->second.value;
+            return true;
+        }
+        if (!stamp.exists || !load(path, value))
+        {
+            if (found != entries.end())
+            {
+                entries.erase(found);
+            }
+            return false;
+        }
+        entries[path] = {stamp, value};
+        return true;
+    }
+
+    // 丢弃全部缓存
+    void Clear() { entries.clear(); }
+};
+
+#endif
@@ -0,0 +1,466 @@
+/*Snake Game - Autopilot
+2023.12
+自动驾驶：根据引擎状态为每一格选择方向，用 A* 寻找到最近食物的路径，再用连通区域检查避免钻进死路
+邻接表和连通分量只在换地图时计算，蛇身的占用时间表在蛇头蛇尾移动时只更新一个格子，规划耗时与地图大小无关
+*/
+
+#ifndef SNAKE_AUTOPILOT_H
+#define SNAKE_AUTOPILOT_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <queue>
+#include <vector>
+
+#include "engine.h"
+
+using namespace std;
+
+// 自动驾驶，每局游戏一个实例，可以在同一个实例上连续玩多局
+class Autopilot
+{
+private:
+    static constexpr int UNREACHABLE = INT_MAX;
+
+    // 地图，用于判断是否换了地图
+    Map map;
+    // 占用表宽度，格子下标为 y * stride + x，与引擎一致
+    int stride = 0;
+    // 每个格子朝四个方向移动后到达的格子，撞到实边界或障碍物为 -1，虚边界已换算到另一侧
+    vector<int> neighbors;
+    // 不考虑蛇身时每个格子所在的连通分量，与蛇头不连通的食物永远吃不到
+    vector<int> component;
+    // 水平和竖直方向能否从一侧穿到另一侧
+    bool wrapX = false;
+    bool wrapY = false;
+
+    // 上一次规划时的食物
+    vector<Food> food;
+    // 与蛇头连通的食物所在的格子
+    vector<int> targets;
+    // 食物上一次变化时的格数
+    long long foodTicks = 0;
+    // 长时间吃不到食物时用来打破绕圈，按本局种子初始化，同一局的选择可以重现
+    Pcg32 random;
+
+    // 蛇头进入每个格子时的序号，只在蛇头移动时更新一个格子
+    // 序号在 (bodySequence - length, bodySequence] 内的格子是蛇身，序号差就是它在蛇身中的位置
+    vector<long long> entered;
+    long long bodySequence = 0;
+    // 上一次规划时的格数和蛇头，用于判断引擎是否只推进了一格
+    long long lastTicks = -1;
+    int lastHead = -1;
+
+    // 搜索时的访问标记，用递增的标记号代替每次清空
+    vector<unsigned int> visited;
+    unsigned int visitStamp = 0;
+    // A* 中每个格子第一步的方向
+    vector<unsigned char> firstMove;
+    // 连通区域检查的队列，(格子, 到达时间)
+    vector<pair<int, int>> frontier;
+
+    int CellIndex(int x, int y) const { return y * stride + x; }
+
+    // 换了地图时重建邻接表和连通分量
+    void BuildNeighbors(const Map &newMap);
+    // 同步蛇身：引擎只推进一格时只记录新的蛇头，否则重新记录整条蛇
+    void SyncBody(const SnakeEngine &engine);
+
+    // 格子在 time 格之后是否可以进入，蛇身第 i 节在 length - i 格之后离开
+    bool IsFreeAt(int cell, int time, int length) const
+    {
+        long long index = bodySequence - entered[cell];
+        return index < 0 || index >= length || time >= length - index;
+    }
+
+    void NextStamp()
+    {
+        if (++visitStamp == 0)
+        {
+            fill(visited.begin(), visited.end(), 0);
+            visitStamp = 1;
+        }
+    }
+
+    // 到最近食物的距离下界，使用可以穿过虚边界的曼哈顿距离，不考虑障碍物和蛇身，是 A* 的可采纳启发函数
+    int Heuristic(int cell) const
+    {
+        int x = cell % stride;
+        int y = cell / stride;
+        int best = UNREACHABLE;
+        for (int target : targets)
+        {
+            int dx = abs(x - target % stride);
+            int dy = abs(y - target / stride);
+            if (wrapX)
+            {
+                dx = min(dx, map.width - dx);
+            }
+            if (wrapY)
+            {
+                dy = min(dy, map.height - dy);
+            }
+            best = min(best, dx + dy);
+        }
+        return best;
+    }
+
+    static long long PathKey(int g, int h)
+    {
+        return (static_cast<long long>(g + h) << 32) + (0xFFFFFFFFLL - g);
+    }
+
+    // 从蛇头出发的 A* 搜索，返回到达最近食物的路径的第一步，找不到时返回 -1
+    int FindPath(int head, Direction current, int length);
+    // 从 start 出发，蛇头在第 time 格到达 start 时能到达的格子数，最多数到 limit，能追上蛇尾时直接返回 limit
+    // optimistic 为真时，区域内的格子够蛇绕到边上的蛇身离开也算作能逃出
+    int CountSpace(int start, int time, int length, int limit, bool optimistic = false);
+
+public:
+    // 为引擎的当前状态选择下一格的方向
+    Direction Plan(const SnakeEngine &engine);
+};
+
+inline void Autopilot::BuildNeighbors(const Map &newMap)
+{
+    map = newMap;
+    stride = map.width + 2;
+    int size = stride * (map.height + 2);
+    neighbors.assign(size * 4, -1);
+    component.assign(size, -1);
+    wrapX = map.real[LEFT] != 1 || map.real[RIGHT] != 1;
+    wrapY = map.real[UP] != 1 || map.real[DOWN] != 1;
+    entered.assign(size, LLONG_MIN / 2);
+    visited.assign(size, 0);
+    firstMove.assign(size, 0);
+    visitStamp = 0;
+    food.clear();
+
+    vector<bool> blocked(size, false);
+    ForEachObstacle(map, [this, &blocked](int x, int y)
+                    { blocked[CellIndex(x + 1, y + 1)] = true; });
+
+    // 离开地图时，实边界挡住去路，虚边界从另一侧进入，与 SnakeEngine::Step 相同
+    for (int y = 1; y <= map.height; ++y)
+    {
+        for (int x = 1; x <= map.width; ++x)
+        {
+            int cell = CellIndex(x, y);
+            if (blocked[cell])
+            {
+                continue;
+            }
+            int moves[4] = {-1, -1, -1, -1};
+            if (y > 1)
+            {
+                moves[UP] = CellIndex(x, y - 1);
+            }
+            else if (map.real[UP] != 1)
+            {
+                moves[UP] = CellIndex(x, map.height);
+            }
+            if (y < map.height)
+            {
+                moves[DOWN] = CellIndex(x, y + 1);
+            }
+            else if (map.real[DOWN] != 1)
+            {
+                moves[DOWN] = CellIndex(x, 1);
+            }
+            if (x > 1)
+            {
+                moves[LEFT] = CellIndex(x - 1, y);
+            }
+            else if (map.real[LEFT] != 1)
+            {
+                moves[LEFT] = CellIndex(map.width, y);
+            }
+            if (x < map.width)
+            {
+                moves[RIGHT] = CellIndex(x + 1, y);
+            }
+            else if (map.real[RIGHT] != 1)
+            {
+                moves[RIGHT] = CellIndex(1, y);
+            }
+            for (int d = 0; d < 4; ++d)
+            {
+                if (moves[d] != -1 && !blocked[moves[d]])
+                {
+                    neighbors[cell * 4 + d] = moves[d];
+                }
+            }
+        }
+    }
+
+    // 广度优先搜索标记连通分量
+    vector<int> queue;
+    int count = 0;
+    for (int y = 1; y <= map.height; ++y)
+    {
+        for (int x = 1; x <= map.width; ++x)
+        {
+            int cell = CellIndex(x, y);
+            if (blocked[cell] || component[cell] != -1)
+            {
+                continue;
+            }
+            component[cell] = count;
+            queue.assign(1, cell);
+            for (size_t i = 0; i < queue.size(); ++i)
+            {
+                for (int d = 0; d < 4; ++d)
+                {
+                    int next = neighbors[queue[i] * 4 + d];
+                    if (next != -1 && component[next] == -1)
+                    {
+                        component[next] = count;
+                        queue.push_back(next);
+                    }
+                }
+            }
+            ++count;
+        }
+    }
+}
+
+inline void Autopilot::SyncBody(const SnakeEngine &engine)
+{
+    Point head = engine.GetSnake(0);
+    int headCell = CellIndex(head.x, head.y);
+    int length = engine.GetLength();
+
+    // 引擎只推进了一格：旧蛇头变成第二节，只有新蛇头需要记录，蛇尾离开的格子自然超出序号范围
+    if (engine.GetTicks() == lastTicks + 1 && length > 1)
+    {
+        Point neck = engine.GetSnake(1);
+        if (CellIndex(neck.x, neck.y) == lastHead)
+        {
+            entered[headCell] = ++bodySequence;
+            lastTicks = engine.GetTicks();
+            lastHead = headCell;
+            return;
+        }
+    }
+
+    // 新的一局或跳过了若干格，重新记录整条蛇，序号跳过一整条蛇的长度，旧记录全部失效
+    bodySequence += static_cast<long long>(map.width) * map.height + length;
+    for (int i = length - 1; i >= 0; --i)
+    {
+        Point body = engine.GetSnake(i);
+        entered[CellIndex(body.x, body.y)] = bodySequence - i;
+    }
+    lastTicks = engine.GetTicks();
+    lastHead = headCell;
+}
+
+inline int Autopilot::FindPath(int head, Direction current, int length)
+{
+    if (targets.empty())
+    {
+        return -1;
+    }
+
+    // 优先级为 f = g + h，f 相同时优先展开 g 大的，沿着一条路径走到底，少展开旁支
+    // 编码为 f * 2^32 + (2^32 - 1 - g)，小的先出队，低 32 位可以还原出 g
+    typedef pair<long long, int> Node;
+    priority_queue<Node, vector<Node>, greater<Node>> open;
+    NextStamp();
+    visited[head] = visitStamp;
+
+    for (int d = 0; d < 4; ++d)
+    {
+        int next = neighbors[head * 4 + d];
+        if (next == -1 || IsOpposite(static_cast<Direction>(d), current) || !IsFreeAt(next, 1, length) ||
+            visited[next] == visitStamp)
+        {
+            continue;
+        }
+        visited[next] = visitStamp;
+        firstMove[next] = d;
+        open.push({PathKey(1, Heuristic(next)), next});
+    }
+
+    while (!open.empty())
+    {
+        Node node = open.top();
+        open.pop();
+        int cell = node.second;
+        if (find(targets.begin(), targets.end(), cell) != targets.end())
+        {
+            return firstMove[cell];
+        }
+        int g = static_cast<int>(0xFFFFFFFFLL - (node.first & 0xFFFFFFFFLL));
+        for (int d = 0; d < 4; ++d)
+        {
+            int next = neighbors[cell * 4 + d];
+            // 被蛇身挡住的格子不标记为已访问，之后更晚到达时蛇身可能已经离开
+            if (next == -1 || visited[next] == visitStamp || !IsFreeAt(next, g + 1, length))
+            {
+                continue;
+            }
+            visited[next] = visitStamp;
+            firstMove[next] = firstMove[cell];
+            open.push({PathKey(g + 1, Heuristic(next)), next});
+        }
+    }
+    return -1;
+}
+
+inline int Autopilot::CountSpace(int start, int time, int length, int limit, bool optimistic)
+{
+    NextStamp();
+    frontier.clear();
+    frontier.push_back({start, time});
+    visited[start] = visitStamp;
+    // 区域边上的蛇身中最早离开的时间
+    int earliestExit = UNREACHABLE;
+    for (size_t i = 0; i < frontier.size() && (int)frontier.size() < limit; ++i)
+    {
+        int cell = frontier[i].first;
+        int arrival = frontier[i].second + 1;
+        for (int d = 0; d < 4; ++d)
+        {
+            int next = neighbors[cell * 4 + d];
+            if (next == -1 || visited[next] == visitStamp)
+            {
+                continue;
+            }
+            long long index = bodySequence - entered[next];
+            if (index >= 0 && index < length)
+            {
+                // 到达时蛇身已经离开，之后一直跟着蛇尾走就不会被困住
+                if (arrival >= length - index)
+                {
+                    return limit;
+                }
+                earliestExit = min(earliestExit, static_cast<int>(length - index));
+                continue;
+            }
+            visited[next] = visitStamp;
+            frontier.push_back({next, arrival});
+        }
+    }
+    if (optimistic && earliestExit != UNREACHABLE && (int)frontier.size() >= earliestExit - time)
+    {
+        return limit;
+    }
+    return min((int)frontier.size(), limit);
+}
+
+inline Direction Autopilot::Plan(const SnakeEngine &engine)
+{
+    const Map &engineMap = engine.GetMap();
+    bool sameMap = engineMap.width == map.width && engineMap.height == map.height &&
+                   engineMap.numOfObstacle == map.numOfObstacle && !neighbors.empty();
+    for (int d = 0; d < 4 && sameMap; ++d)
+    {
+        sameMap = engineMap.real[d] == map.real[d];
+    }
+    for (int i = 0; i < engineMap.numOfObstacle && sameMap; ++i)
+    {
+        sameMap = engineMap.obstacle[i].x == map.obstacle[i].x && engineMap.obstacle[i].y == map.obstacle[i].y;
+    }
+    sameMap = sameMap && engineMap.obstacleRects == map.obstacleRects;
+    if (!sameMap)
+    {
+        BuildNeighbors(engineMap);
+        lastTicks = -1;
+    }
+
+    const vector<Food> &engineFood = engine.GetFood();
+    bool sameFood = engineFood.size() == food.size();
+    for (size_t i = 0; i < engineFood.size() && sameFood; ++i)
+    {
+        sameFood = engineFood[i].x == food[i].x && engineFood[i].y == food[i].y && engineFood[i].value == food[i].value;
+    }
+    if (!sameFood || engine.GetTicks() < foodTicks)
+    {
+        food = engineFood;
+        foodTicks = engine.GetTicks();
+        if (foodTicks == 0)
+        {
+            random.Seed(engine.GetSeed(), 2);
+        }
+    }
+
+    SyncBody(engine);
+
+    // 只把与蛇头连通的食物作为目标，吃不到的食物不会让搜索走遍整个分量
+    targets.clear();
+    for (const Food &item : food)
+    {
+        int cell = CellIndex(item.x, item.y);
+        if (item.value != 0 && component[cell] == component[lastHead])
+        {
+            targets.push_back(cell);
+        }
+    }
+
+    Direction current = engine.GetDirection();
+    int length = engine.GetLength();
+    int head = lastHead;
+
+    // 走满一整张地图的格数还没吃到食物，说明在绕圈，放宽安全检查，空间相同时随机选择，让蛇身换一种形状
+    long long area = static_cast<long long>(map.width) * map.height;
+    long long hungry = engine.GetTicks() - foodTicks;
+    bool stalled = hungry > area;
+    // 绕圈时走向食物的路径每一圈都一样，在同一处被安全检查拦下；每走满一张地图的格数，就有一整条蛇长的格数不追食物，
+    // 只在能追上蛇尾的方向中随机选择，打乱蛇身的形状，再重新寻路
+    bool escaping = stalled && hungry % (area + length) >= area;
+
+    // 沿最短路径走一步后，蛇头所在的区域要能装下整条蛇，否则可能把自己困死
+    int move = escaping ? -1 : FindPath(head, current, length);
+    if (move != -1 && CountSpace(neighbors[head * 4 + move], 1, length, length + 1, stalled) > length)
+    {
+        return static_cast<Direction>(move);
+    }
+
+    // 没有安全的路径时，走向空间最大的方向，空间相同时走向离食物更近的方向
+    int bestMove = -1;
+    int bestSpace = -1;
+    int bestDistance = UNREACHABLE;
+    int ties = 0;
+    int limit = max(length + 1, 2 * length);
+    for (int d = 0; d < 4; ++d)
+    {
+        int next = neighbors[head * 4 + d];
+        if (next == -1 || IsOpposite(static_cast<Direction>(d), current) || !IsFreeAt(next, 1, length))
+        {
+            continue;
+        }
+        int space = CountSpace(next, 1, length, limit);
+        bool better = space > bestSpace;
+        if (space == bestSpace)
+        {
+            better = stalled ? random.NextBounded(++ties + 1) == 0 : Heuristic(next) < bestDistance;
+        }
+        else if (better)
+        {
+            ties = 0;
+        }
+        if (better)
+        {
+            bestMove = d;
+            bestSpace = space;
+            bestDistance = Heuristic(next);
+        }
+    }
+    if (bestMove != -1)
+    {
+        return static_cast<Direction>(bestMove);
+    }
+
+    // 没有空闲的格子时，优先走向不是边界或障碍物的方向，例如这一格吃到食物后可能仍会离开的蛇尾，都不行时保持原方向
+    for (int d = 0; d < 4; ++d)
+    {
+        if (neighbors[head * 4 + d] != -1 && !IsOpposite(static_cast<Direction>(d), current))
+        {
+            return static_cast<Direction>(d);
+        }
+    }
+    return current;
+}
+
+#endif
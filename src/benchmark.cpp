@@ -0,0 +1,674 @@
+/*Snake Game - Benchmark
+2023.12
+引擎性能测试：测量不同蛇长度下每推进一格的耗时，不同地图大小下自动驾驶每格的规划耗时
+以及同一张小地图上 SnakeEngine 与位棋盘引擎随机对局的耗时，蒙特卡洛树搜索在不同线程数下每秒的模拟次数
+和 10000x10000 稀疏地图上每格的耗时与棋盘占用的内存
+自动驾驶回归检查：默认地图上一组固定种子的对局都不应推进到格数上限，有绕圈不吃食物的局时返回 1
+热点测试：不同地图大小和蛇长度下的推进一格、不同占用率下的食物生成、渲染到内存、保存和读取记录
+每项输出每次操作的纳秒数和堆分配次数、字节数，--csv 时只运行热点测试并输出 CSV，便于比较每次改动前后的结果
+用法：benchmark [--csv]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <filesystem>
+
+#include "engine.h"
+#include "autopilot.h"
+#include "bitboard.h"
+#include "mcts.h"
+#include "record.h"
+#include "render.h"
+
+using namespace std;
+
+// 渲染测试假定的终端大小，与游戏无法获取终端大小时的默认值相同
+const int DEFAULT_BENCHMARK_COLUMNS = 80;
+const int DEFAULT_BENCHMARK_ROWS = 24;
+
+// 全局堆分配计数，替换默认的 operator new，数组版本默认也会调用这里
+atomic<long long> allocationCount(0);
+atomic<long long> allocationBytes(0);
+
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(size, memory_order_relaxed);
+    void *pointer = malloc(size ? size : 1);
+    if (pointer == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return pointer;
+}
+
+// 与 operator new 对应，两种版本都直接调用 free
+// 内联到 delete 表达式后 GCC 看到 new 分配的指针传给 free，会误报 -Wmismatched-new-delete，这里的 new 本身就用 malloc 分配
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *pointer) noexcept { free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { free(pointer); }
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// 一项热点测试的结果，params 为分号分隔的参数，例如 map=64x64;length=32
+struct BenchmarkResult
+{
+    string name;
+    string params;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+// 分段计时器，只累计 Start 与 Stop 之间的耗时和堆分配，用于把每局的初始化等准备工作排除在外
+class Meter
+{
+private:
+    chrono::steady_clock::time_point start;
+    long long startCount = 0;
+    long long startBytes = 0;
+
+public:
+    double nanoseconds = 0;
+    long long allocations = 0;
+    long long bytes = 0;
+
+    void Start()
+    {
+        startCount = allocationCount.load(memory_order_relaxed);
+        startBytes = allocationBytes.load(memory_order_relaxed);
+        start = chrono::steady_clock::now();
+    }
+
+    void Stop()
+    {
+        nanoseconds += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        allocations += allocationCount.load(memory_order_relaxed) - startCount;
+        bytes += allocationBytes.load(memory_order_relaxed) - startBytes;
+    }
+
+    BenchmarkResult Result(const string &name, const string &params, long long ops) const
+    {
+        return {name, params, nanoseconds / ops, (double)allocations / ops, (double)bytes / ops};
+    }
+};
+
+// 构造一张 width x height、左右为虚边界的空地图，蛇向右移动时会从右侧穿出再从左侧进入
+Map MakeCorridorMap(int width, int height)
+{
+    Map map;
+    map.width = width;
+    map.height = height;
+    map.real[UP] = 1;
+    map.real[DOWN] = 1;
+    map.real[LEFT] = 0;
+    map.real[RIGHT] = 0;
+    map.numOfObstacle = 0;
+    map.mapPath = "benchmark";
+    return map;
+}
+
+// 测量长度为 length 的蛇每推进一格的平均耗时，单位为纳秒
+double MeasureTick(int length, long long ticks)
+{
+    // 地图宽度为蛇长度的两倍，蛇一直向右移动，蛇头永远追不上蛇尾
+    Map map = MakeCorridorMap(2 * length + 8, 3);
+    Config config;
+    config.gameDifficulty = 10;
+    config.randomSeed = 1;
+    config.numOfFood = 1;
+    config.configPath = "benchmark";
+
+    SnakeEngine engine;
+    engine.Reset(map, config, length);
+
+    // 预热
+    for (int i = 0; i < 1000; ++i)
+    {
+        engine.Step(RIGHT);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < ticks; ++i)
+    {
+        engine.Step(RIGHT);
+    }
+    double nanoseconds = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    if (engine.IsGameOver())
+    {
+        cout << "Warning: snake of length " << length << " died during the benchmark." << endl;
+    }
+    return nanoseconds / ticks;
+}
+
+// 测量自动驾驶在 size x size 的地图上每格的规划耗时，单位为微秒，返回平均值，worst 为最大值
+// setup 为第一次规划的耗时，包括换地图时建立邻接表和连通分量，单位为毫秒
+double MeasurePlan(int size, long long ticks, double &worst, double &setup)
+{
+    // 四周为虚边界，规划时需要处理从另一侧穿出
+    Map map = MakeCorridorMap(size, size);
+    map.real[UP] = 0;
+    map.real[DOWN] = 0;
+    Config config;
+    config.gameDifficulty = 10;
+    config.randomSeed = 1;
+    config.numOfFood = 3;
+    config.configPath = "benchmark";
+
+    SnakeEngine engine;
+    Autopilot autopilot;
+    engine.Reset(map, config);
+    auto start = chrono::steady_clock::now();
+    engine.Step(autopilot.Plan(engine));
+    setup = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    double total = 0;
+    worst = 0;
+    for (long long i = 0; i < ticks; ++i)
+    {
+        if (engine.IsGameOver())
+        {
+            config.randomSeed++;
+            engine.Reset(map, config);
+        }
+        auto start = chrono::steady_clock::now();
+        Direction direction = autopilot.Plan(engine);
+        double microseconds = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        total += microseconds;
+        worst = max(worst, microseconds);
+        engine.Step(direction);
+    }
+    return total / ticks;
+}
+
+// 自动驾驶在与默认地图、默认配置相同的 15 x 15 实边界地图上用种子 1 到 games 各玩一局，返回推进到 maxTicks 格还没结束的局数
+// 绕圈吃不到食物的局会一直玩到上限，这一项应当为 0
+int CountAutopilotTimeouts(int games, long long maxTicks)
+{
+    Map map = MakeCorridorMap(15, 15);
+    map.real[LEFT] = 1;
+    map.real[RIGHT] = 1;
+    Config config;
+    config.gameDifficulty = 1;
+    config.numOfFood = 1;
+    config.foodProb[0] = 0.6;
+    config.foodProb[1] = 0.3;
+    config.foodProb[2] = 0.1;
+    config.configPath = "benchmark";
+
+    SnakeEngine engine;
+    Autopilot autopilot;
+    int timeouts = 0;
+    for (int seed = 1; seed <= games; ++seed)
+    {
+        engine.ResetWithSeed(map, config, seed);
+        while (!engine.IsGameOver() && engine.GetTicks() < maxTicks)
+        {
+            engine.Step(autopilot.Plan(engine));
+        }
+        if (!engine.IsGameOver())
+        {
+            ++timeouts;
+        }
+    }
+    return timeouts;
+}
+
+// 在 20 x 20 的虚边界地图上随机对局，测量每推进一格的平均耗时，单位为纳秒，包括每局开始时的初始化
+template <class Engine>
+double MeasureRandomPlay(Engine &engine, long long ticks)
+{
+    Map map = MakeCorridorMap(20, 20);
+    map.real[UP] = 0;
+    map.real[DOWN] = 0;
+    Config config;
+    config.gameDifficulty = 10;
+    config.numOfFood = 3;
+    config.configPath = "benchmark";
+
+    Pcg32 inputRandom(1, 1);
+    uint64_t seed = 1;
+    engine.ResetWithSeed(map, config, seed);
+    Direction direction = RIGHT;
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < ticks; ++i)
+    {
+        if (engine.IsGameOver())
+        {
+            engine.ResetWithSeed(map, config, ++seed);
+        }
+        if (inputRandom.NextBounded(10) == 0)
+        {
+            direction = static_cast<Direction>(inputRandom.NextBounded(4));
+        }
+        engine.Step(direction);
+    }
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ticks;
+}
+
+// 在 10000 x 10000、有 obstacles 个随机障碍物的地图上随机对局，返回每推进一格的平均耗时，单位为纳秒，不含每局开始时的初始化
+// resetMs 为一局开始时初始化的平均耗时，boardBytes 为棋盘和蛇身占用的内存
+double MeasureHugeMap(int obstacles, long long ticks, double &resetMs, size_t &boardBytes)
+{
+    Map map = MakeCorridorMap(10000, 10000);
+    Pcg32 obstacleRandom(1, 2);
+    map.numOfObstacle = obstacles;
+    for (int i = 0; i < obstacles; ++i)
+    {
+        map.obstacle.push_back({(int)obstacleRandom.NextBounded(map.width), (int)obstacleRandom.NextBounded(map.height)});
+    }
+    Config config;
+    config.gameDifficulty = 10;
+    config.numOfFood = 3;
+    config.configPath = "benchmark";
+
+    SnakeEngine engine;
+    Pcg32 inputRandom(1, 1);
+    uint64_t seed = 1;
+    int games = 0;
+    double resetTotal = 0;
+    Direction direction = RIGHT;
+    auto start = chrono::steady_clock::now();
+    for (long long i = 0; i < ticks; ++i)
+    {
+        if (i == 0 || engine.IsGameOver())
+        {
+            auto resetStart = chrono::steady_clock::now();
+            engine.ResetWithSeed(map, config, seed++);
+            resetTotal += chrono::duration<double, milli>(chrono::steady_clock::now() - resetStart).count();
+            ++games;
+        }
+        if (inputRandom.NextBounded(10) == 0)
+        {
+            direction = static_cast<Direction>(inputRandom.NextBounded(4));
+        }
+        engine.Step(direction);
+    }
+    double total = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    resetMs = resetTotal / games;
+    boardBytes = engine.GetBoardBytes();
+    return (total - resetTotal) * 1e6 / ticks;
+}
+
+// 用 threads 个线程在 20 x 20 的地图上搜索 plans 次，每次 budgetMs 毫秒，返回每秒的模拟次数
+double MeasureRollouts(int threads, int plans, long long budgetMs)
+{
+    Map map = MakeCorridorMap(20, 20);
+    Config config;
+    config.gameDifficulty = 10;
+    config.randomSeed = 1;
+    config.numOfFood = 3;
+    config.configPath = "benchmark";
+
+    SnakeEngine engine;
+    MctsPlayer player(threads, 1);
+    engine.Reset(map, config);
+    double total = 0;
+    for (int i = 0; i < plans; ++i)
+    {
+        if (engine.IsGameOver())
+        {
+            config.randomSeed++;
+            engine.Reset(map, config);
+        }
+        engine.Step(player.Plan(engine, budgetMs));
+        total += player.GetRolloutsPerSecond();
+    }
+    return total / plans;
+}
+
+// 热点测试使用的配置
+Config MakeSuiteConfig(int numOfFood)
+{
+    Config config;
+    config.gameDifficulty = 10;
+    config.randomSeed = 1;
+    config.numOfFood = numOfFood;
+    config.configPath = "benchmark";
+    return config;
+}
+
+string MapParam(int size)
+{
+    return "map=" + to_string(size) + "x" + to_string(size);
+}
+
+// 推进一格（游戏中的 MoveSnake）：size x size 的走廊地图上长度为 length 的蛇一直向右移动，吃到食物变长撞死后重新开始，重新开始不计时
+BenchmarkResult BenchStep(int size, int length, long long ticks)
+{
+    Map map = MakeCorridorMap(size, size);
+    Config config = MakeSuiteConfig(3);
+    SnakeEngine engine;
+    uint64_t seed = 1;
+    engine.ResetWithSeed(map, config, seed, length);
+
+    Meter meter;
+    meter.Start();
+    for (long long i = 0; i < ticks; ++i)
+    {
+        if (!engine.Step(RIGHT))
+        {
+            meter.Stop();
+            engine.ResetWithSeed(map, config, ++seed, length);
+            meter.Start();
+        }
+    }
+    meter.Stop();
+    return meter.Result("step", MapParam(size) + ";length=" + to_string(length), ticks);
+}
+
+// 生成食物：用随机障碍物把地图占满 fill%，反复把食物移到新的空闲格子，蛇所在的一行不放障碍物
+BenchmarkResult BenchFood(int size, int fill, long long respawns)
+{
+    Map map = MakeCorridorMap(size, size);
+    Pcg32 obstacleRandom(1, 3);
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            if (y != size / 2 && (int)obstacleRandom.NextBounded(100) < fill)
+            {
+                map.obstacle.push_back({x, y});
+            }
+        }
+    }
+    map.numOfObstacle = map.obstacle.size();
+
+    SnakeEngine engine;
+    Config config = MakeSuiteConfig(3);
+    engine.ResetWithSeed(map, config, 1);
+    Meter meter;
+    meter.Start();
+    for (long long i = 0; i < respawns; ++i)
+    {
+        engine.RespawnFood(i % config.numOfFood);
+    }
+    meter.Stop();
+    return meter.Result("food", MapParam(size) + ";fill=" + to_string(fill), respawns);
+}
+
+// 按游戏中 DrawMap 的方式，用同一套视口跟随和绘制函数把画面和下方文字画到渲染器中，差分输出只生成到内存，不写终端
+void DrawFrame(TerminalRenderer &renderer, const SnakeEngine &engine, int &viewX, int &viewY, int viewWidth, int viewHeight)
+{
+    vector<string> lines;
+    lines.push_back("Current score: " + to_string(engine.GetScore()));
+    lines.push_back("Config: " + engine.GetConfig().configPath);
+    lines.push_back("Map: " + engine.GetMap().mapPath);
+    lines.push_back("Enter space to pause, w/a/s/d to move.");
+
+    int columns = engine.GetMap().width + 2;
+    int rows = engine.GetMap().height + 2;
+    Point head = engine.GetSnake(0);
+    FollowTarget(viewX, viewY, head.x, head.y, viewWidth, viewHeight, columns, rows);
+    if (viewWidth < columns || viewHeight < rows)
+    {
+        lines.push_back(ViewportText(viewX, viewY, viewWidth, viewHeight, columns, rows));
+    }
+    RenderScreen(renderer, [&engine](int x, int y)
+                 { return engine.GetScreen(x, y); },
+                 engine.IsGameOver(), viewX, viewY, viewWidth, viewHeight, lines);
+}
+
+// 渲染一帧：在 80x24 的终端上随机对局，每格之后绘制一帧，只计绘制的耗时
+BenchmarkResult BenchDraw(int size, long long ticks)
+{
+    Map map = MakeCorridorMap(size, size);
+    map.real[UP] = 0;
+    map.real[DOWN] = 0;
+    Config config = MakeSuiteConfig(3);
+    int viewWidth = min(size + 2, DEFAULT_BENCHMARK_COLUMNS);
+    int viewHeight = min(size + 2, DEFAULT_BENCHMARK_ROWS - 6);
+
+    SnakeEngine engine;
+    TerminalRenderer renderer;
+    Pcg32 inputRandom(1, 1);
+    uint64_t seed = 1;
+    engine.ResetWithSeed(map, config, seed);
+    Direction direction = RIGHT;
+    int viewX = -1;
+    int viewY = -1;
+    Meter meter;
+    for (long long i = 0; i < ticks; ++i)
+    {
+        if (engine.IsGameOver())
+        {
+            engine.ResetWithSeed(map, config, ++seed);
+        }
+        if (inputRandom.NextBounded(10) == 0)
+        {
+            direction = static_cast<Direction>(inputRandom.NextBounded(4));
+        }
+        engine.Step(direction);
+        meter.Start();
+        DrawFrame(renderer, engine, viewX, viewY, viewWidth, viewHeight);
+        meter.Stop();
+    }
+    return meter.Result("draw", MapParam(size), ticks);
+}
+
+// 用自动驾驶在 size x size 的地图上玩一局，最多 maxTicks 格，返回事件记录
+GameRecord PlayRecord(int size, long long maxTicks)
+{
+    GameRecord record;
+    record.map = MakeCorridorMap(size, size);
+    record.map.real[UP] = 0;
+    record.map.real[DOWN] = 0;
+    record.config = MakeSuiteConfig(3);
+    record.seed = 1;
+
+    SnakeEngine engine;
+    Autopilot autopilot;
+    engine.ResetWithSeed(record.map, record.config, record.seed);
+    Direction direction = engine.GetDirection();
+    while (!engine.IsGameOver() && engine.GetTicks() < maxTicks)
+    {
+        Direction next = autopilot.Plan(engine);
+        if (next != direction)
+        {
+            record.inputs.push_back({engine.GetTicks(), next});
+            direction = next;
+        }
+        engine.Step(direction);
+    }
+    record.ticks = engine.GetTicks();
+    return record;
+}
+
+// 保存和读取记录：事件记录和二进制画面记录各写入、读取 repeats 次，读取画面记录时按顺序解码每一帧
+void BenchRecord(int size, long long maxTicks, int repeats, vector<BenchmarkResult> &results)
+{
+    GameRecord record = PlayRecord(size, maxTicks);
+    string params = MapParam(size) + ";ticks=" + to_string(record.ticks);
+    string path = (filesystem::temp_directory_path() / "snake-benchmark.rec").string();
+
+    Meter saveEvents;
+    Meter loadEvents;
+    for (int i = 0; i < repeats; ++i)
+    {
+        saveEvents.Start();
+        WriteGameRecord(path, record);
+        saveEvents.Stop();
+        loadEvents.Start();
+        ifstream recordFile(path);
+        GameRecord loaded;
+        bool ok = ReadGameRecord(recordFile, loaded);
+        loadEvents.Stop();
+        if (!ok || loaded.inputs.size() != record.inputs.size())
+        {
+            cout << "Warning: failed to read back the event record." << endl;
+        }
+    }
+
+    Meter saveFrames;
+    Meter loadFrames;
+    for (int i = 0; i < repeats; ++i)
+    {
+        saveFrames.Start();
+        WriteFrameRecord(path, record);
+        saveFrames.Stop();
+        loadFrames.Start();
+        FrameRecordReader reader;
+        bool ok = reader.Open(path);
+        for (long long frame = 0; ok && frame < reader.GetFrameCount(); ++frame)
+        {
+            ok = reader.Seek(frame);
+        }
+        loadFrames.Stop();
+        if (!ok)
+        {
+            cout << "Warning: failed to read back the frame record." << endl;
+        }
+    }
+    filesystem::remove(path);
+
+    results.push_back(saveEvents.Result("save-events", params, repeats));
+    results.push_back(loadEvents.Result("load-events", params, repeats));
+    results.push_back(saveFrames.Result("save-frames", params, repeats));
+    results.push_back(loadFrames.Result("load-frames", params, repeats));
+}
+
+// 运行全部热点测试
+vector<BenchmarkResult> RunSuite()
+{
+    vector<BenchmarkResult> results;
+
+    // 稀疏地图从 2048x2048 开始
+    const int stepSizes[] = {16, 64, 256, 1024, 2048};
+    for (int size : stepSizes)
+    {
+        results.push_back(BenchStep(size, 4, 200000));
+        results.push_back(BenchStep(size, size / 2, 200000));
+    }
+
+    // 普通地图从空闲格子集合中取，稀疏地图随机取格子，占用率越高取到空闲格子需要的次数越多
+    // 稀疏地图几乎占满时会逐行扫描，单次耗时与地图面积成正比，不在这里测量
+    const int foodSizes[] = {64, 256, 1024, 2048};
+    const int fills[] = {0, 50, 90, 99};
+    for (int size : foodSizes)
+    {
+        for (int fill : fills)
+        {
+            if ((long long)size * size > SPARSE_MAP_CELLS && fill > 90)
+            {
+                continue;
+            }
+            results.push_back(BenchFood(size, fill, 200000));
+        }
+    }
+
+    const int drawSizes[] = {16, 64, 256, 1024};
+    for (int size : drawSizes)
+    {
+        results.push_back(BenchDraw(size, 20000));
+    }
+
+    BenchRecord(20, 5000, 20, results);
+    BenchRecord(64, 5000, 5, results);
+    return results;
+}
+
+void PrintSuite(const vector<BenchmarkResult> &results, bool csv)
+{
+    if (csv)
+    {
+        cout << "benchmark,params,ns_per_op,allocs_per_op,bytes_per_op" << endl;
+        for (const BenchmarkResult &result : results)
+        {
+            cout << result.name << "," << result.params << "," << fixed << setprecision(1) << result.nsPerOp << ","
+                 << setprecision(3) << result.allocsPerOp << "," << setprecision(1) << result.bytesPerOp << endl;
+        }
+        return;
+    }
+    cout << left << setw(14) << "Benchmark" << setw(26) << "Params" << setw(16) << "ns/op" << setw(14) << "allocs/op" << "bytes/op" << endl;
+    for (const BenchmarkResult &result : results)
+    {
+        cout << left << setw(14) << result.name << setw(26) << result.params << fixed << setprecision(1) << setw(16) << result.nsPerOp
+             << setprecision(3) << setw(14) << result.allocsPerOp << setprecision(1) << result.bytesPerOp << endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool csv = argc > 1 && string(argv[1]) == "--csv";
+    PrintSuite(RunSuite(), csv);
+    if (csv)
+    {
+        return 0;
+    }
+    cout << endl;
+
+    const long long ticks = 200000;
+    const int lengths[] = {4, 16, 64, 256, 1024, 4096, 16384, 65536};
+
+    cout << left << setw(12) << "Length" << setw(12) << "ns/tick" << endl;
+    for (int length : lengths)
+    {
+        double nanoseconds = MeasureTick(length, ticks);
+        cout << left << setw(12) << length << fixed << setprecision(1) << nanoseconds << endl;
+    }
+
+    SnakeEngine gridEngine;
+    BitboardEngine<20, 20> bitboardEngine;
+    cout << endl;
+    cout << left << setw(12) << "Engine" << setw(12) << "ns/tick" << endl;
+    cout << left << setw(12) << "grid" << fixed << setprecision(1) << MeasureRandomPlay(gridEngine, 2000000) << endl;
+    cout << left << setw(12) << "bitboard" << fixed << setprecision(1) << MeasureRandomPlay(bitboardEngine, 2000000) << endl;
+
+    // 稀疏地图的内存与障碍物数量成正比，与地图面积无关
+    const int obstacleCounts[] = {0, 10000, 100000};
+    cout << endl;
+    cout << left << setw(12) << "Obstacles" << setw(12) << "ns/tick" << setw(12) << "reset ms" << setw(12) << "board MB" << endl;
+    for (int obstacles : obstacleCounts)
+    {
+        double resetMs;
+        size_t boardBytes;
+        double nanoseconds = MeasureHugeMap(obstacles, 200000, resetMs, boardBytes);
+        cout << left << setw(12) << obstacles << fixed << setprecision(1) << setw(12) << nanoseconds
+             << setw(12) << resetMs << boardBytes / 1e6 << endl;
+    }
+
+    // 难度 10 时每格 100 毫秒，规划耗时要远小于一格
+    const int sizes[] = {16, 32, 64, 128, 256, 512, 1024};
+    cout << endl;
+    cout << left << setw(12) << "Board" << setw(12) << "us/plan" << setw(12) << "worst us" << setw(12) << "setup ms" << endl;
+    for (int size : sizes)
+    {
+        double worst;
+        double setup;
+        double microseconds = MeasurePlan(size, 20000, worst, setup);
+        cout << left << setw(12) << (to_string(size) + "x" + to_string(size)) << fixed << setprecision(1)
+             << setw(12) << microseconds << setw(12) << worst << setup << endl;
+    }
+
+    const int stallGames = 200;
+    int timeouts = CountAutopilotTimeouts(stallGames, 100000);
+    cout << endl;
+    cout << "Autopilot games hitting the tick cap: " << timeouts << " of " << stallGames << endl;
+    if (timeouts > 0)
+    {
+        cout << "Error: the autopilot stalled without eating." << endl;
+    }
+
+    // 每个线程独立建树，模拟次数应随线程数增长，直到超过硬件线程数
+    int hardwareThreads = max(1u, thread::hardware_concurrency());
+    cout << endl;
+    cout << left << setw(12) << "Threads" << setw(12) << "rollouts/s" << endl;
+    for (int threads = 1; threads <= hardwareThreads * 2; threads *= 2)
+    {
+        cout << left << setw(12) << threads << fixed << setprecision(0) << MeasureRollouts(threads, 50, 20) << endl;
+    }
+    return timeouts > 0 ? 1 : 0;
+}
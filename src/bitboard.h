@@ -0,0 +1,674 @@
+/*Snake Game - Bitboard Engine
+2023.12
+位棋盘引擎：地图大小在编译期确定，蛇身、障碍物和食物各用一个定长位图表示
+碰撞检测是一次位测试，空闲格子数是 popcount，连通区域用整字移位扩散，没有堆内存，复制一局游戏只是复制一块定长内存
+用于前瞻搜索和大批量模拟；食物在空闲格子中的选取顺序与 SnakeEngine 不同，同一个种子得到的对局不同，保存记录和回放仍使用 SnakeEngine
+*/
+
+#ifndef SNAKE_BITBOARD_H
+#define SNAKE_BITBOARD_H
+
+#include <cstdint>
+#include <utility>
+
+#include "engine.h"
+
+using namespace std;
+
+// 支持的地图大小范围，与创建地图时的限制相同
+const int BITBOARD_MIN_SIZE = 8;
+const int BITBOARD_MAX_SIZE = 20;
+
+inline int PopCount64(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(value);
+#else
+    int count = 0;
+    for (; value != 0; value &= value - 1)
+    {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+inline int TrailingZeros64(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    for (; (value & 1) == 0; value >>= 1)
+    {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// 定长位图，第 i 位在第 i / 64 个字的第 i % 64 位
+template <int BITS>
+class Bitboard
+{
+public:
+    static const int WORDS = (BITS + 63) / 64;
+
+private:
+    uint64_t words[WORDS] = {};
+
+public:
+    bool Test(int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void Set(int i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+    void Reset(int i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    void Clear()
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            words[i] = 0;
+        }
+    }
+
+    int Count() const
+    {
+        int count = 0;
+        for (int i = 0; i < WORDS; ++i)
+        {
+            count += PopCount64(words[i]);
+        }
+        return count;
+    }
+
+    bool Any() const
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            if (words[i] != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 第 k 个为 1 的位的下标，从 0 开始数，调用者保证 k < Count()
+    int Select(int k) const
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            int count = PopCount64(words[i]);
+            if (k < count)
+            {
+                uint64_t word = words[i];
+                for (; k > 0; --k)
+                {
+                    word &= word - 1;
+                }
+                return i * 64 + TrailingZeros64(word);
+            }
+            k -= count;
+        }
+        return -1;
+    }
+
+    // 整体左移 n 位，即下标增大 n，超出 BITS 的位被丢弃
+    Bitboard operator<<(int n) const
+    {
+        Bitboard result;
+        int wordShift = n >> 6;
+        int bitShift = n & 63;
+        for (int i = WORDS - 1; i >= wordShift; --i)
+        {
+            uint64_t value = words[i - wordShift] << bitShift;
+            if (bitShift != 0 && i - wordShift - 1 >= 0)
+            {
+                value |= words[i - wordShift - 1] >> (64 - bitShift);
+            }
+            result.words[i] = value;
+        }
+        result.Trim();
+        return result;
+    }
+
+    // 整体右移 n 位，即下标减小 n
+    Bitboard operator>>(int n) const
+    {
+        Bitboard result;
+        int wordShift = n >> 6;
+        int bitShift = n & 63;
+        for (int i = 0; i + wordShift < WORDS; ++i)
+        {
+            uint64_t value = words[i + wordShift] >> bitShift;
+            if (bitShift != 0 && i + wordShift + 1 < WORDS)
+            {
+                value |= words[i + wordShift + 1] << (64 - bitShift);
+            }
+            result.words[i] = value;
+        }
+        return result;
+    }
+
+    Bitboard &operator|=(const Bitboard &other)
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    Bitboard &operator&=(const Bitboard &other)
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+
+    Bitboard operator|(const Bitboard &other) const { return Bitboard(*this) |= other; }
+    Bitboard operator&(const Bitboard &other) const { return Bitboard(*this) &= other; }
+
+    Bitboard operator~() const
+    {
+        Bitboard result;
+        for (int i = 0; i < WORDS; ++i)
+        {
+            result.words[i] = ~words[i];
+        }
+        result.Trim();
+        return result;
+    }
+
+    bool operator==(const Bitboard &other) const
+    {
+        for (int i = 0; i < WORDS; ++i)
+        {
+            if (words[i] != other.words[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator!=(const Bitboard &other) const { return !(*this == other); }
+
+private:
+    // 清除最后一个字中超出 BITS 的位
+    void Trim()
+    {
+        if (BITS % 64 != 0)
+        {
+            words[WORDS - 1] &= (uint64_t(1) << (BITS % 64)) - 1;
+        }
+    }
+};
+
+// 位棋盘引擎，规则与 SnakeEngine 相同，W 和 H 为地图宽高，格子下标为 y * (W + 2) + x，包括边界
+template <int W, int H>
+class BitboardEngine
+{
+public:
+    static const int STRIDE = W + 2;
+    static const int CELLS = (W + 2) * (H + 2);
+    typedef Bitboard<CELLS> Board;
+
+    // 食物数量上限，与配置文件的限制相同
+    static const int MAX_FOOD = 5;
+
+private:
+    // 地图内部的格子，不包括边界
+    Board interior;
+    // 障碍物
+    Board obstacles;
+    // 蛇身，包括蛇头
+    Board body;
+    // 食物
+    Board foodCells;
+    // 各方向是否为实边界
+    bool real[4];
+    // 虚边界一侧的内部格子，扩散时从这些格子穿到另一侧，实边界一侧为空
+    Board wrapLeft;
+    Board wrapRight;
+    Board wrapUp;
+    Board wrapDown;
+
+    // 蛇身环形缓冲区，从 headIndex 开始依次为蛇头到蛇尾
+    uint16_t snake[W * H];
+    int headIndex;
+    int snakeLength;
+    Direction currentDirection;
+
+    // 食物的格子和分数，分数为 0 表示该食物已不存在
+    int numOfFood;
+    int food[MAX_FOOD];
+    int foodValue[MAX_FOOD];
+    double foodProb[3];
+
+    int score;
+    long long ticks;
+    bool gameOver;
+    bool gameWon;
+    EndReason endReason;
+    uint64_t seed;
+    Pcg32 random;
+
+    int BodyIndex(int i) const { return (headIndex + i) % (W * H); }
+
+    // 生成第 i 个食物，从空闲格子中均匀选取
+    void GenerateFood(int i)
+    {
+        Board free = interior & ~(obstacles | body | foodCells);
+        int count = free.Count();
+        if (count == 0)
+        {
+            food[i] = -1;
+            foodValue[i] = 0;
+            for (int j = 0; j < numOfFood; ++j)
+            {
+                if (foodValue[j] != 0)
+                {
+                    return;
+                }
+            }
+            gameWon = true;
+            gameOver = true;
+            endReason = END_WIN;
+            return;
+        }
+
+        food[i] = free.Select(random.NextBounded(count));
+        foodCells.Set(food[i]);
+        double randValue = random.NextDouble();
+        if (randValue < foodProb[0])
+        {
+            foodValue[i] = 1;
+        }
+        else if (randValue < foodProb[0] + foodProb[1])
+        {
+            foodValue[i] = 2;
+        }
+        else
+        {
+            foodValue[i] = 3;
+        }
+    }
+
+    // 设置地图，建立内部格子和障碍物位图
+    void SetMap(const Map &map)
+    {
+        interior.Clear();
+        obstacles.Clear();
+        for (int y = 1; y <= H; ++y)
+        {
+            for (int x = 1; x <= W; ++x)
+            {
+                interior.Set(y * STRIDE + x);
+            }
+        }
+        ForEachObstacle(map, [this](int x, int y)
+                        { obstacles.Set((y + 1) * STRIDE + x + 1); });
+        for (int d = 0; d < 4; ++d)
+        {
+            real[d] = map.real[d] == 1;
+        }
+        wrapLeft = real[LEFT] ? Board() : Column(1);
+        wrapRight = real[RIGHT] ? Board() : Column(W);
+        wrapUp = real[UP] ? Board() : Row(1);
+        wrapDown = real[DOWN] ? Board() : Row(H);
+    }
+
+    void SetConfig(const Config &config)
+    {
+        numOfFood = config.numOfFood < MAX_FOOD ? config.numOfFood : MAX_FOOD;
+        for (int i = 0; i < 3; ++i)
+        {
+            foodProb[i] = config.foodProb[i];
+        }
+    }
+
+public:
+    BitboardEngine() : headIndex(0), snakeLength(0), currentDirection(RIGHT), numOfFood(0), score(0), ticks(0), gameOver(true), gameWon(false), endReason(END_NONE), seed(0) {}
+
+    // 按地图和配置开始新的一局，地图大小必须为 W x H
+    void Reset(const Map &map, const Config &config, int initialLength = 4)
+    {
+        uint64_t newSeed = static_cast<uint64_t>(config.randomSeed);
+        if (config.randomSeed == -1)
+        {
+            random_device device;
+            newSeed = (static_cast<uint64_t>(device()) << 32) | device();
+        }
+        ResetWithSeed(map, config, newSeed, initialLength);
+    }
+
+    void ResetWithSeed(const Map &map, const Config &config, uint64_t newSeed, int initialLength = 4)
+    {
+        SetMap(map);
+        SetConfig(config);
+        body.Clear();
+        foodCells.Clear();
+        headIndex = 0;
+        snakeLength = initialLength;
+        currentDirection = RIGHT;
+        score = 0;
+        ticks = 0;
+        gameOver = false;
+        gameWon = false;
+        endReason = END_NONE;
+
+        // 与 SnakeEngine 相同，蛇头在地图中央，蛇身向左展开
+        for (int i = 0; i < snakeLength; ++i)
+        {
+            snake[i] = (H / 2 + 1) * STRIDE + W / 2 + 1 - i;
+            body.Set(snake[i]);
+        }
+
+        seed = newSeed;
+        random.Seed(seed);
+        for (int i = 0; i < numOfFood; ++i)
+        {
+            foodValue[i] = 0;
+        }
+        for (int i = 0; i < numOfFood; ++i)
+        {
+            GenerateFood(i);
+        }
+    }
+
+    // 从 SnakeEngine 的当前局面继续，之后的食物由 newSeed 决定，用于从真实对局出发做前瞻搜索
+    void Load(const SnakeEngine &engine, uint64_t newSeed)
+    {
+        SetMap(engine.GetMap());
+        SetConfig(engine.GetConfig());
+        body.Clear();
+        foodCells.Clear();
+        headIndex = 0;
+        snakeLength = engine.GetLength();
+        for (int i = 0; i < snakeLength; ++i)
+        {
+            Point point = engine.GetSnake(i);
+            snake[i] = point.y * STRIDE + point.x;
+            body.Set(snake[i]);
+        }
+        const vector<Food> &engineFood = engine.GetFood();
+        for (int i = 0; i < numOfFood; ++i)
+        {
+            foodValue[i] = engineFood[i].value;
+            food[i] = foodValue[i] != 0 ? engineFood[i].y * STRIDE + engineFood[i].x : -1;
+            if (foodValue[i] != 0)
+            {
+                foodCells.Set(food[i]);
+            }
+        }
+        currentDirection = engine.GetDirection();
+        score = engine.GetScore();
+        ticks = engine.GetTicks();
+        gameOver = engine.IsGameOver();
+        gameWon = engine.IsWon();
+        endReason = engine.GetEndReason();
+        seed = newSeed;
+        random.Seed(seed);
+    }
+
+    // 朝 direction 方向推进一格，规则与 SnakeEngine::Step 相同
+    bool Step(Direction direction)
+    {
+        if (gameOver)
+        {
+            return false;
+        }
+        ++ticks;
+        if (!IsOpposite(direction, currentDirection))
+        {
+            currentDirection = direction;
+        }
+
+        // 撞到实边界结束
+        int next = NextCell(currentDirection);
+        if (next == -1)
+        {
+            gameOver = true;
+            endReason = END_WALL;
+            return false;
+        }
+
+        // 撞到障碍物或蛇身结束，蛇尾会在本格移走，撞到蛇尾不算
+        int tail = snake[BodyIndex(snakeLength - 1)];
+        if (obstacles.Test(next) || (body.Test(next) && next != tail))
+        {
+            gameOver = true;
+            endReason = obstacles.Test(next) ? END_OBSTACLE : END_SELF;
+            return false;
+        }
+
+        body.Reset(tail);
+        headIndex = (headIndex + W * H - 1) % (W * H);
+        snake[headIndex] = next;
+        body.Set(next);
+
+        if (foodCells.Test(next))
+        {
+            for (int i = 0; i < numOfFood; ++i)
+            {
+                if (food[i] == next && foodValue[i] != 0)
+                {
+                    score += foodValue[i];
+                    // 蛇尾仍在原槽位，长度加 1 即可
+                    snakeLength++;
+                    body.Set(tail);
+                    foodCells.Reset(next);
+                    GenerateFood(i);
+                }
+            }
+        }
+        return !gameOver;
+    }
+
+    // 蛇头朝 direction 方向移动一格后的格子，虚边界从另一侧穿出，撞到实边界返回 -1
+    int NextCell(Direction direction) const
+    {
+        int head = snake[headIndex];
+        int x = head % STRIDE;
+        int y = head / STRIDE;
+        switch (direction)
+        {
+        case UP:
+            y--;
+            break;
+        case DOWN:
+            y++;
+            break;
+        case LEFT:
+            x--;
+            break;
+        case RIGHT:
+            x++;
+            break;
+        }
+        if ((y == 0 && real[UP]) || (y == H + 1 && real[DOWN]) || (x == 0 && real[LEFT]) || (x == W + 1 && real[RIGHT]))
+        {
+            return -1;
+        }
+        if (y == 0)
+        {
+            y = H;
+        }
+        else if (y == H + 1)
+        {
+            y = 1;
+        }
+        if (x == 0)
+        {
+            x = W;
+        }
+        else if (x == W + 1)
+        {
+            x = 1;
+        }
+        return y * STRIDE + x;
+    }
+
+    // 朝 direction 方向走一步是否不会立即结束游戏，与当前方向相反的方向视为不可走
+    bool IsSafe(Direction direction) const
+    {
+        if (IsOpposite(direction, currentDirection))
+        {
+            return false;
+        }
+        int next = NextCell(direction);
+        return next != -1 && !obstacles.Test(next) && (!body.Test(next) || next == snake[BodyIndex(snakeLength - 1)]);
+    }
+
+    // 格子到最近食物的曼哈顿距离，虚边界可以穿过，不考虑障碍物和蛇身，没有食物时返回 W + H
+    int FoodDistance(int cell) const
+    {
+        int x = cell % STRIDE;
+        int y = cell / STRIDE;
+        int best = W + H;
+        for (int i = 0; i < numOfFood; ++i)
+        {
+            if (foodValue[i] == 0)
+            {
+                continue;
+            }
+            int dx = x > food[i] % STRIDE ? x - food[i] % STRIDE : food[i] % STRIDE - x;
+            int dy = y > food[i] / STRIDE ? y - food[i] / STRIDE : food[i] / STRIDE - y;
+            if (!real[LEFT] || !real[RIGHT])
+            {
+                dx = dx < W - dx ? dx : W - dx;
+            }
+            if (!real[UP] || !real[DOWN])
+            {
+                dy = dy < H - dy ? dy : H - dy;
+            }
+            best = dx + dy < best ? dx + dy : best;
+        }
+        return best;
+    }
+
+    // 重新设置之后生成食物所用的随机种子，前瞻搜索中同一局面可以尝试不同的食物位置
+    void Reseed(uint64_t newSeed)
+    {
+        seed = newSeed;
+        random.Seed(seed);
+    }
+
+    void Stop()
+    {
+        if (!gameOver)
+        {
+            gameOver = true;
+            endReason = END_STOPPED;
+        }
+    }
+
+    Direction GetDirection() const { return currentDirection; }
+    int GetScore() const { return score; }
+    long long GetTicks() const { return ticks; }
+    bool IsGameOver() const { return gameOver; }
+    bool IsWon() const { return gameWon; }
+    EndReason GetEndReason() const { return endReason; }
+    uint64_t GetSeed() const { return seed; }
+    int GetLength() const { return snakeLength; }
+    // 第 i 节蛇身的格子下标，0 为蛇头
+    int GetSnake(int i) const { return snake[BodyIndex(i)]; }
+    // 空闲格子数量，不包括食物
+    int GetFreeCount() const { return (interior & ~(obstacles | body | foodCells)).Count(); }
+    const Board &GetBody() const { return body; }
+    const Board &GetFood() const { return foodCells; }
+    const Board &GetObstacles() const { return obstacles; }
+
+    // 走一步能到达的格子，按边界属性从另一侧穿出，结果不限于可通行的格子
+    Board Expand(const Board &cells) const
+    {
+        Board result = cells | (cells << 1) | (cells >> 1) | (cells << STRIDE) | (cells >> STRIDE);
+        result |= (cells & wrapLeft) << (W - 1);
+        result |= (cells & wrapRight) >> (W - 1);
+        result |= (cells & wrapUp) << (STRIDE * (H - 1));
+        result |= (cells & wrapDown) >> (STRIDE * (H - 1));
+        return result;
+    }
+
+    // 与 cell 相邻且不是蛇身和障碍物的格子数，用来避开走进去就出不来的死胡同
+    int CountExits(int cell) const
+    {
+        Board start;
+        start.Set(cell);
+        return (Expand(start) & interior & ~(obstacles | body | start)).Count();
+    }
+
+    // 从 start 出发不经过蛇身和障碍物能到达的格子数，不包括 start 本身
+    int FloodFill(int start) const
+    {
+        Board passable = interior & ~(obstacles | body);
+        Board reached;
+        reached.Set(start);
+        while (true)
+        {
+            Board next = Expand(reached) & passable;
+            next.Set(start);
+            if (next == reached)
+            {
+                break;
+            }
+            reached = next;
+        }
+        return reached.Count() - 1;
+    }
+
+    // 地图第 x 列的内部格子
+    static Board Column(int x)
+    {
+        Board result;
+        for (int y = 1; y <= H; ++y)
+        {
+            result.Set(y * STRIDE + x);
+        }
+        return result;
+    }
+
+    // 地图第 y 行的内部格子
+    static Board Row(int y)
+    {
+        Board result;
+        for (int x = 1; x <= W; ++x)
+        {
+            result.Set(y * STRIDE + x);
+        }
+        return result;
+    }
+};
+
+// 按运行时的地图大小选择对应的位棋盘引擎，构造一个引擎交给 f，f 的参数为 auto &
+// 地图大小超出范围时返回 false，调用者应改用 SnakeEngine
+template <int W = BITBOARD_MIN_SIZE, int H = BITBOARD_MIN_SIZE, class F>
+bool WithBitboardEngine(int width, int height, F &&f)
+{
+    if constexpr (W > BITBOARD_MAX_SIZE)
+    {
+        return false;
+    }
+    else if constexpr (H > BITBOARD_MAX_SIZE)
+    {
+        return WithBitboardEngine<W + 1, BITBOARD_MIN_SIZE>(width, height, forward<F>(f));
+    }
+    else
+    {
+        if (width == W && height == H)
+        {
+            BitboardEngine<W, H> engine;
+            f(engine);
+            return true;
+        }
+        return WithBitboardEngine<W, H + 1>(width, height, forward<F>(f));
+    }
+}
+
+inline bool FitsBitboard(const Map &map)
+{
+    return map.width >= BITBOARD_MIN_SIZE && map.width <= BITBOARD_MAX_SIZE &&
+           map.height >= BITBOARD_MIN_SIZE && map.height <= BITBOARD_MAX_SIZE;
+}
+
+#endif
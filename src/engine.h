@@ -0,0 +1,1083 @@
+/*Snake Game - Engine
+2023.12
+不依赖控制台与平台 API 的游戏规则核心，供游戏本体与无界面模拟器共用
+*/
+
+#ifndef SNAKE_ENGINE_H
+#define SNAKE_ENGINE_H
+
+#include <algorithm>
+#include <fstream>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 方向
+enum Direction
+{
+    UP,
+    DOWN,
+    LEFT,
+    RIGHT
+};
+
+// 坐标
+struct Point
+{
+    int x;
+    int y;
+};
+
+// 食物
+struct Food
+{
+    int x;
+    int y;
+    int value;
+};
+
+// 配置
+struct Config
+{
+    // 难度，1-10，蛇移动速度为每 1 / gameDifficulty 秒移动一格
+    int gameDifficulty;
+    // 随机种子
+    int randomSeed = -1;
+    // 食物数量，1-5
+    int numOfFood;
+    // 食物概率，0-1，分别为 1、2、3 分食物的概率
+    double foodProb[3] = {0.1, 0.3, 0.6};
+    // 配置文件路径
+    string configPath;
+};
+
+// 矩形障碍物，覆盖 x 到 x + width - 1 列、y 到 y + height - 1 行的格子，坐标与单格障碍物一样从 0 开始
+// 高为 1 的矩形就是一行中连续的一段障碍物
+struct ObstacleRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool operator==(const ObstacleRect &other) const
+    {
+        return x == other.x && y == other.y && width == other.width && height == other.height;
+    }
+};
+
+// 地图
+struct Map
+{
+    // 地图宽度
+    int width;
+    // 地图高度
+    int height;
+    // 地图边界属性，0 为虚边界，1 为实边界
+    int real[4];
+    // 障碍物数量
+    int numOfObstacle;
+    // 障碍物坐标
+    vector<Point> obstacle;
+    // 矩形障碍物，来自二进制地图文件，可以与单格障碍物重叠
+    vector<ObstacleRect> obstacleRects;
+    // 地图文件路径
+    string mapPath;
+};
+
+// 对地图上的每个障碍物格子调用 visit(x, y)，包括单格障碍物和矩形覆盖的格子，坐标从 0 开始，重叠的格子会访问多次
+template <class Visit>
+inline void ForEachObstacle(const Map &map, Visit visit)
+{
+    for (int i = 0; i < map.numOfObstacle; ++i)
+    {
+        visit(map.obstacle[i].x, map.obstacle[i].y);
+    }
+    for (const ObstacleRect &rect : map.obstacleRects)
+    {
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            for (int x = rect.x; x < rect.x + rect.width; ++x)
+            {
+                visit(x, y);
+            }
+        }
+    }
+}
+
+// 地图宽高的下限和上限，下限保证开局横放的蛇身和蛇头前方的一格都在地图内
+const int MIN_MAP_SIZE = 8;
+const int MAX_MAP_SIZE = 10000;
+// 配置中难度和食物数量的范围，新建配置和读取记录时按同样的范围检查
+const int MIN_DIFFICULTY = 1;
+const int MAX_DIFFICULTY = 10;
+const int MIN_NUM_OF_FOOD = 1;
+const int MAX_NUM_OF_FOOD = 5;
+// 地图面积超过该格数时按稀疏地图处理：不再维护与面积成正比的空闲格子集合，画面记录改存事件记录
+const int SPARSE_MAP_CELLS = 1 << 20;
+
+// 二维网格，所有格子按行连续存放在一块内存中，下标为 y * width + x
+// 整块内存可以直接 memcpy 复制和 memcmp 比较
+template <class T>
+class Grid
+{
+private:
+    int width = 0;
+    int height = 0;
+    vector<T> cells;
+
+public:
+    Grid() {}
+    Grid(int newWidth, int newHeight, T value) { Assign(newWidth, newHeight, value); }
+
+    // 重新设置大小并把所有格子设为 value，大小不变时不重新分配内存
+    void Assign(int newWidth, int newHeight, T value)
+    {
+        width = newWidth;
+        height = newHeight;
+        cells.assign(static_cast<size_t>(width) * height, value);
+    }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Size() const { return cells.size(); }
+    int Index(int x, int y) const { return y * width + x; }
+
+    T &At(int x, int y) { return cells[y * width + x]; }
+    const T &At(int x, int y) const { return cells[y * width + x]; }
+    T &operator[](int index) { return cells[index]; }
+    const T &operator[](int index) const { return cells[index]; }
+
+    T *Data() { return cells.data(); }
+    const T *Data() const { return cells.data(); }
+    // 第 y 行的起始位置
+    T *Row(int y) { return cells.data() + static_cast<size_t>(y) * width; }
+    const T *Row(int y) const { return cells.data() + static_cast<size_t>(y) * width; }
+
+    void Swap(Grid &other)
+    {
+        swap(width, other.width);
+        swap(height, other.height);
+        cells.swap(other.cells);
+    }
+
+    bool operator==(const Grid &other) const { return width == other.width && cells == other.cells; }
+    bool operator!=(const Grid &other) const { return !(*this == other); }
+};
+
+// 分块稀疏网格，按 CHUNK_SIZE x CHUNK_SIZE 分块，只为含有非默认值格子的块分配内存
+// 每块记录非默认值格子的数量，全部恢复为默认值时释放该块，内存占用与网格上的内容成正比
+// 块指针表每 CHUNK_SIZE * CHUNK_SIZE 个格子占一个指针，10000x10000 的地图约 3 MB
+// 小网格可以选择整块连续存放，省去每次访问时查找块的开销
+template <class T>
+class ChunkedGrid
+{
+public:
+    static const int CHUNK_BITS = 4;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+
+private:
+    struct Chunk
+    {
+        T cells[CHUNK_SIZE * CHUNK_SIZE];
+        // 非默认值格子的数量
+        int used;
+    };
+
+    int width = 0;
+    int height = 0;
+    // 每行的块数
+    int chunkColumns = 0;
+    // 默认值，未分配的块中所有格子都是默认值
+    T background = T();
+    vector<unique_ptr<Chunk>> chunks;
+    // 已分配的块数
+    size_t chunkCount = 0;
+    // 是否整块连续存放，此时格子保存在 cells 中，下标为 y * width + x
+    bool flat = false;
+    vector<T> cells;
+
+    int ChunkIndex(int x, int y) const { return (y >> CHUNK_BITS) * chunkColumns + (x >> CHUNK_BITS); }
+    static int Offset(int x, int y) { return ((y & (CHUNK_SIZE - 1)) << CHUNK_BITS) | (x & (CHUNK_SIZE - 1)); }
+
+    // 释放全部恢复为默认值的块
+    void Release(unique_ptr<Chunk> &chunk)
+    {
+        chunk.reset();
+        --chunkCount;
+    }
+
+public:
+    ChunkedGrid() {}
+    ChunkedGrid(int newWidth, int newHeight, T value, bool newFlat = false) { Assign(newWidth, newHeight, value, newFlat); }
+    ChunkedGrid(const ChunkedGrid &other) { *this = other; }
+    ChunkedGrid(ChunkedGrid &&other) = default;
+    ChunkedGrid &operator=(ChunkedGrid &&other) = default;
+
+    // 逐块复制，只复制已分配的块
+    ChunkedGrid &operator=(const ChunkedGrid &other)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+        width = other.width;
+        height = other.height;
+        chunkColumns = other.chunkColumns;
+        background = other.background;
+        chunkCount = other.chunkCount;
+        flat = other.flat;
+        cells = other.cells;
+        chunks.clear();
+        chunks.resize(other.chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            if (other.chunks[i])
+            {
+                chunks[i].reset(new Chunk(*other.chunks[i]));
+            }
+        }
+        return *this;
+    }
+
+    // 重新设置大小，释放所有块，所有格子恢复为默认值 value
+    // newFlat 为真时整块连续存放，内存与面积成正比，只适合小网格
+    void Assign(int newWidth, int newHeight, T value, bool newFlat = false)
+    {
+        width = newWidth;
+        height = newHeight;
+        background = value;
+        flat = newFlat;
+        chunks.clear();
+        chunkCount = 0;
+        if (flat)
+        {
+            chunkColumns = 0;
+            cells.assign(static_cast<size_t>(width) * height, background);
+            return;
+        }
+        cells.clear();
+        cells.shrink_to_fit();
+        chunkColumns = (width + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        int chunkRows = (height + CHUNK_SIZE - 1) >> CHUNK_BITS;
+        chunks.resize(static_cast<size_t>(chunkColumns) * chunkRows);
+    }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    T Background() const { return background; }
+
+    T At(int x, int y) const
+    {
+        if (flat)
+        {
+            return cells[static_cast<size_t>(y) * width + x];
+        }
+        const Chunk *chunk = chunks[ChunkIndex(x, y)].get();
+        return chunk ? chunk->cells[Offset(x, y)] : background;
+    }
+
+    // 设置格子，所在块不存在时分配，块中的格子全部恢复为默认值时释放
+    void Set(int x, int y, T value)
+    {
+        if (!flat && value == background && !chunks[ChunkIndex(x, y)])
+        {
+            return;
+        }
+        Modify(x, y, [&value](T &cell)
+               { cell = value; });
+    }
+
+    // 就地修改格子，只查找一次所在块，update 接受格子的引用
+    template <class Update>
+    void Modify(int x, int y, Update update)
+    {
+        if (flat)
+        {
+            update(cells[static_cast<size_t>(y) * width + x]);
+            return;
+        }
+        unique_ptr<Chunk> &chunk = chunks[ChunkIndex(x, y)];
+        if (!chunk)
+        {
+            chunk.reset(new Chunk);
+            fill(chunk->cells, chunk->cells + CHUNK_SIZE * CHUNK_SIZE, background);
+            chunk->used = 0;
+            ++chunkCount;
+        }
+        // 先把默认值读到局部变量，写入格子后不必重新读取
+        const T empty = background;
+        T &cell = chunk->cells[Offset(x, y)];
+        int wasUsed = cell != empty;
+        update(cell);
+        int used = chunk->used + (cell != empty) - wasUsed;
+        chunk->used = used;
+        if (used == 0)
+        {
+            Release(chunk);
+        }
+    }
+
+    // 对每个非默认值的格子调用 visit(x, y, value)，分块存放时只遍历已分配的块
+    template <class Visit>
+    void ForEach(Visit visit) const
+    {
+        if (flat)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    T value = cells[static_cast<size_t>(y) * width + x];
+                    if (value != background)
+                    {
+                        visit(x, y, value);
+                    }
+                }
+            }
+            return;
+        }
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            const Chunk *chunk = chunks[i].get();
+            if (!chunk)
+            {
+                continue;
+            }
+            int baseX = static_cast<int>(i % chunkColumns) << CHUNK_BITS;
+            int baseY = static_cast<int>(i / chunkColumns) << CHUNK_BITS;
+            for (int offset = 0; offset < CHUNK_SIZE * CHUNK_SIZE; ++offset)
+            {
+                if (chunk->cells[offset] != background)
+                {
+                    visit(baseX + (offset & (CHUNK_SIZE - 1)), baseY + (offset >> CHUNK_BITS), chunk->cells[offset]);
+                }
+            }
+        }
+    }
+
+    // 已分配的块数
+    size_t ChunkCount() const { return chunkCount; }
+    // 占用的内存字节数，包括块指针表
+    size_t MemoryBytes() const
+    {
+        return cells.capacity() * sizeof(T) + chunks.capacity() * sizeof(unique_ptr<Chunk>) + chunkCount * sizeof(Chunk);
+    }
+};
+
+// PCG32 随机数生成器，每局游戏各自持有一个，结果与平台无关，不同实例互不影响
+class Pcg32
+{
+private:
+    uint64_t state;
+    uint64_t increment;
+
+public:
+    Pcg32(uint64_t seed = 0, uint64_t stream = 0) { Seed(seed, stream); }
+
+    // 设置种子和序列号，序列号不同的生成器产生互相独立的序列
+    void Seed(uint64_t seed, uint64_t stream = 0)
+    {
+        state = 0;
+        increment = (stream << 1) | 1;
+        Next();
+        state += seed;
+        Next();
+    }
+
+    // 生成一个 32 位随机数
+    uint32_t Next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+
+    // 生成 [0, bound) 内均匀分布的整数
+    uint32_t NextBounded(uint32_t bound)
+    {
+        uint64_t product = static_cast<uint64_t>(Next()) * bound;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < bound)
+        {
+            // 拒绝落在不完整区间内的结果，保证均匀
+            uint32_t threshold = -bound % bound;
+            while (low < threshold)
+            {
+                product = static_cast<uint64_t>(Next()) * bound;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    // 生成 [0, 1) 内均匀分布的小数
+    double NextDouble()
+    {
+        return (Next() >> 5) * (1.0 / 134217728.0);
+    }
+};
+
+// 占用标记，按位组合保存在占用表中
+enum CellFlag : unsigned char
+{
+    CELL_WALL = 1,
+    CELL_OBSTACLE = 2,
+    CELL_BODY = 4
+};
+
+// 棋盘上的一格，画面字符和占用标记放在一起，一次查找同时得到两者
+struct BoardCell
+{
+    // 画面字符
+    char screen;
+    // 占用标记
+    unsigned char flags;
+
+    bool operator==(const BoardCell &other) const { return screen == other.screen && flags == other.flags; }
+    bool operator!=(const BoardCell &other) const { return !(*this == other); }
+};
+
+// 游戏结束原因
+enum EndReason
+{
+    // 游戏仍在进行
+    END_NONE,
+    // 撞到实边界
+    END_WALL,
+    // 撞到障碍物
+    END_OBSTACLE,
+    // 撞到自己
+    END_SELF,
+    // 占满地图获胜
+    END_WIN,
+    // 被强制结束，例如玩家退出
+    END_STOPPED
+};
+
+// 结束原因的名称，用于统计输出
+inline const char *EndReasonName(EndReason reason)
+{
+    switch (reason)
+    {
+    case END_WALL:
+        return "wall";
+    case END_OBSTACLE:
+        return "obstacle";
+    case END_SELF:
+        return "self";
+    case END_WIN:
+        return "win";
+    case END_STOPPED:
+        return "stopped";
+    default:
+        return "none";
+    }
+}
+
+// 判断两个方向是否相反
+inline bool IsOpposite(Direction a, Direction b)
+{
+    return (a == UP && b == DOWN) || (a == DOWN && b == UP) ||
+           (a == LEFT && b == RIGHT) || (a == RIGHT && b == LEFT);
+}
+
+// 把 w/a/s/d 转换为方向，其他字符返回 false
+inline bool KeyToDirection(char key, Direction &direction)
+{
+    switch (key)
+    {
+    case 'w':
+        direction = UP;
+        return true;
+    case 's':
+        direction = DOWN;
+        return true;
+    case 'a':
+        direction = LEFT;
+        return true;
+    case 'd':
+        direction = RIGHT;
+        return true;
+    }
+    return false;
+}
+
+// 把方向转换为 w/a/s/d
+inline char DirectionToKey(Direction direction)
+{
+    const char keys[4] = {'w', 's', 'a', 'd'};
+    return keys[direction];
+}
+
+// 读取地图文件，文件不存在或格式错误时返回 false
+inline bool ReadMapFile(const string &path, Map &map)
+{
+    ifstream mapFile(path);
+    if (!mapFile)
+    {
+        return false;
+    }
+
+    map.mapPath = path;
+    map.numOfObstacle = 0;
+    map.obstacle.clear();
+    map.obstacleRects.clear();
+
+    mapFile >> map.width >> map.height;
+    mapFile >> map.real[UP] >> map.real[DOWN] >> map.real[LEFT] >> map.real[RIGHT];
+    mapFile >> map.numOfObstacle;
+    if (!mapFile || map.width < MIN_MAP_SIZE || map.height < MIN_MAP_SIZE || map.width > MAX_MAP_SIZE || map.height > MAX_MAP_SIZE || map.numOfObstacle < 0)
+    {
+        return false;
+    }
+
+    // 边读边解析，内存只随障碍物数量增长；不按文件头预留，避免损坏的文件头一次申请大量内存
+    for (int i = 0; i < map.numOfObstacle; ++i)
+    {
+        int x, y;
+        if (!(mapFile >> x >> y) || x < 0 || x >= map.width || y < 0 || y >= map.height)
+        {
+            return false;
+        }
+        map.obstacle.push_back({x, y});
+    }
+    return true;
+}
+
+// 读取配置文件，文件不存在时返回 false
+inline bool ReadConfigFile(const string &path, Config &config)
+{
+    ifstream configFile(path);
+    if (!configFile)
+    {
+        return false;
+    }
+
+    config.configPath = path;
+    configFile >> config.gameDifficulty;
+    configFile >> config.randomSeed;
+    configFile >> config.numOfFood;
+    configFile >> config.foodProb[0] >> config.foodProb[1] >> config.foodProb[2];
+    return true;
+}
+
+// 游戏引擎，只维护游戏状态，每次 Step 推进一格，不做任何输入输出
+class SnakeEngine
+{
+private:
+    // 当前方向
+    Direction currentDirection;
+    // 蛇头即将移动到的位置
+    Point snakeHead;
+    // 蛇身环形缓冲区，从 headIndex 开始依次为蛇头到蛇尾，稀疏地图上容量按需翻倍
+    vector<Point> snake;
+    // 蛇头在环形缓冲区中的下标
+    int headIndex;
+    // 蛇长度
+    int snakeLength;
+    // 食物
+    vector<Food> food;
+    // 配置
+    Config config;
+    // 地图
+    Map map;
+
+    // 当前分数
+    int score;
+    // 已经推进的格数
+    long long ticks;
+    // 游戏是否结束
+    bool gameOver;
+    // 是否占满整个地图获胜
+    bool gameWon;
+    // 结束原因
+    EndReason endReason;
+    // 本局实际使用的随机种子，配置为 -1 时随机生成
+    uint64_t seed;
+    // 随机数生成器，只在 Reset 时根据种子初始化一次
+    Pcg32 random;
+
+    // 当前游戏画面和占用表，分块存储，只有含有内容的块占用内存
+    // 画面字符 0 为空格，1/2/3 为食物，# 为蛇头，* 为蛇身，O 为障碍物，|/- 为实边界
+    // 占用标记记录实边界、障碍物和蛇身，随蛇头蛇尾移动增量更新
+    ChunkedGrid<BoardCell> board;
+    // 是否为稀疏地图，面积超过 SPARSE_MAP_CELLS 时食物改用拒绝采样生成
+    bool sparse;
+    // 空闲格子数量，不含食物
+    int freeCount;
+    // 空闲格子集合，只用于非稀疏地图
+    // freeCells 紧凑保存空闲格子的下标，freePos 记录每个格子在 freeCells 中的位置，不空闲为 -1
+    vector<int> freeCells;
+    vector<int> freePos;
+
+    // 生成第 i 个食物
+    void GenerateFood(int i);
+    // 在稀疏地图上随机选择一个空闲格子
+    Point PickFreeCell();
+    // 格子既不被占用也没有食物
+    bool IsFree(int x, int y) const { return board.At(x, y) == BoardCell{'0', 0}; }
+    // 把格子加入空闲集合
+    void InsertFree(int x, int y);
+    // 把格子移出空闲集合，不在集合中时忽略
+    void EraseFree(int x, int y);
+    // 蛇身占满环形缓冲区时把容量翻倍，蛇头移到下标 0
+    void GrowSnake();
+    // 第 i 节蛇身在环形缓冲区中的下标，0 为蛇头
+    int BodyIndex(int i) const { return (headIndex + i) % (int)snake.size(); }
+    // 坐标在空闲格子集合中的下标
+    int CellIndex(int x, int y) const { return y * (map.width + 2) + x; }
+    // 设置画面字符
+    void Draw(int x, int y, char symbol)
+    {
+        board.Modify(x, y, [symbol](BoardCell &cell)
+                     { cell.screen = symbol; });
+    }
+    // 设置画面字符并加上占用标记，返回原来的占用标记
+    unsigned char Mark(int x, int y, char symbol, unsigned char flag)
+    {
+        unsigned char flags = 0;
+        board.Modify(x, y, [symbol, flag, &flags](BoardCell &cell)
+                     { flags = cell.flags; cell.screen = symbol; cell.flags |= flag; });
+        return flags;
+    }
+    // 清除占用标记并把画面恢复为空格，返回剩下的占用标记
+    unsigned char Unmark(int x, int y, unsigned char flag)
+    {
+        unsigned char flags = 0;
+        board.Modify(x, y, [flag, &flags](BoardCell &cell)
+                     { cell.screen = '0'; flags = cell.flags &= ~flag; });
+        return flags;
+    }
+
+public:
+    SnakeEngine() : currentDirection(RIGHT), snakeHead{0, 0}, headIndex(0), snakeLength(0), score(0), ticks(0), gameOver(true), gameWon(false), endReason(END_NONE), seed(0), sparse(false), freeCount(0) {}
+
+    // 按地图和配置开始新的一局，initialLength 为蛇的初始长度
+    void Reset(const Map &newMap, const Config &newConfig, int initialLength = 4);
+    // 使用指定的随机种子开始新的一局，用于回放时重现同一局游戏
+    void ResetWithSeed(const Map &newMap, const Config &newConfig, uint64_t newSeed, int initialLength = 4);
+    // 朝 direction 方向推进一格，与当前方向相反时保持原方向，返回游戏是否仍在进行
+    bool Step(Direction direction);
+    // 把第 i 个食物移到另一个随机的空闲格子，原来的格子重新变为空闲
+    void RespawnFood(int i);
+    // 强制结束游戏，例如玩家退出
+    void Stop()
+    {
+        if (!gameOver)
+        {
+            gameOver = true;
+            endReason = END_STOPPED;
+        }
+    }
+
+    Direction GetDirection() const { return currentDirection; }
+    int GetScore() const { return score; }
+    long long GetTicks() const { return ticks; }
+    bool IsGameOver() const { return gameOver; }
+    bool IsWon() const { return gameWon; }
+    EndReason GetEndReason() const { return endReason; }
+    uint64_t GetSeed() const { return seed; }
+    // 空闲格子数量
+    int GetFreeCount() const { return freeCount; }
+    int GetLength() const { return snakeLength; }
+    // 第 i 节蛇身的坐标，0 为蛇头
+    Point GetSnake(int i) const { return snake[BodyIndex(i)]; }
+    const vector<Food> &GetFood() const { return food; }
+    const Config &GetConfig() const { return config; }
+    const Map &GetMap() const { return map; }
+    // 画面中 (x, y) 处的字符
+    char GetScreen(int x, int y) const { return board.At(x, y).screen; }
+    // 把整个画面展开到稠密网格中，供画面记录使用
+    void CopyScreen(Grid<char> &screen) const
+    {
+        screen.Assign(board.Width(), board.Height(), '0');
+        board.ForEach([&screen](int x, int y, BoardCell cell)
+                      { screen.At(x, y) = cell.screen; });
+    }
+    // 棋盘和蛇身占用的内存字节数
+    size_t GetBoardBytes() const
+    {
+        return board.MemoryBytes() + snake.capacity() * sizeof(Point) + (freeCells.capacity() + freePos.capacity()) * sizeof(int);
+    }
+};
+
+inline void SnakeEngine::Reset(const Map &newMap, const Config &newConfig, int initialLength)
+{
+    // 配置为 -1 时随机生成种子
+    uint64_t newSeed = static_cast<uint64_t>(newConfig.randomSeed);
+    if (newConfig.randomSeed == -1)
+    {
+        random_device device;
+        newSeed = (static_cast<uint64_t>(device()) << 32) | device();
+    }
+    ResetWithSeed(newMap, newConfig, newSeed, initialLength);
+}
+
+inline void SnakeEngine::ResetWithSeed(const Map &newMap, const Config &newConfig, uint64_t newSeed, int initialLength)
+{
+    map = newMap;
+    config = newConfig;
+    long long area = static_cast<long long>(map.width) * map.height;
+    sparse = area > SPARSE_MAP_CELLS;
+
+    // 初始化 screen、snake、food、score、gameOver 变量
+    // 稀疏地图分块存储，普通地图整块连续存放
+    board.Assign(map.width + 2, map.height + 2, {'0', 0}, !sparse);
+    // 普通地图上蛇最长占满整个地图，一次分配足够的容量，之后增长不再重新分配
+    // 稀疏地图上按需翻倍，内存随蛇长增长
+    int capacity = sparse ? max(initialLength, 1024) : static_cast<int>(area);
+    snake.assign(capacity, {0, 0});
+    headIndex = 0;
+    snakeLength = initialLength;
+    food.clear();
+    food.resize(config.numOfFood);
+    score = 0;
+    ticks = 0;
+    gameOver = false;
+    gameWon = false;
+    endReason = END_NONE;
+
+    // 根据地图大小初始化蛇的坐标
+    snake[0].x = map.width / 2 + 1;
+    snake[0].y = map.height / 2 + 1;
+    // 记录被蛇身和障碍物占用的内部格子数，用于统计空闲格子
+    long long occupied = Mark(snake[0].x, snake[0].y, '#', CELL_BODY) == 0;
+
+    for (int i = 1; i < snakeLength; ++i)
+    {
+        snake[i].x = map.width / 2 - i + 1;
+        snake[i].y = map.height / 2 + 1;
+        occupied += Mark(snake[i].x, snake[i].y, '*', CELL_BODY) == 0;
+    }
+
+    // 设置障碍物
+    ForEachObstacle(map, [this, &occupied](int x, int y)
+                    { occupied += Mark(x + 1, y + 1, 'O', CELL_OBSTACLE) == 0; });
+
+    // 设置边界
+    if (map.real[LEFT] == 1)
+    {
+        for (int i = 0; i < map.height + 2; ++i)
+        {
+            Mark(0, i, '|', CELL_WALL);
+        }
+    }
+    if (map.real[RIGHT] == 1)
+    {
+        for (int i = 0; i < map.height + 2; ++i)
+        {
+            Mark(map.width + 1, i, '|', CELL_WALL);
+        }
+    }
+    if (map.real[UP] == 1)
+    {
+        for (int i = 0; i < map.width + 2; ++i)
+        {
+            Mark(i, 0, '-', CELL_WALL);
+        }
+    }
+    if (map.real[DOWN] == 1)
+    {
+        for (int i = 0; i < map.width + 2; ++i)
+        {
+            Mark(i, map.height + 1, '-', CELL_WALL);
+        }
+    }
+
+    // 建立空闲格子集合，稀疏地图只统计数量：面积减去被占用的内部格子
+    freeCells.clear();
+    freePos.clear();
+    if (sparse)
+    {
+        freeCells.shrink_to_fit();
+        freePos.shrink_to_fit();
+        freeCount = static_cast<int>(area - occupied);
+    }
+    else
+    {
+        freeCount = 0;
+        freeCells.reserve(area);
+        freePos.assign(static_cast<size_t>(map.width + 2) * (map.height + 2), -1);
+        for (int y = 1; y <= map.height; ++y)
+        {
+            for (int x = 1; x <= map.width; ++x)
+            {
+                if (board.At(x, y).flags == 0)
+                {
+                    InsertFree(x, y);
+                }
+            }
+        }
+    }
+
+    // 根据随机种子初始化随机数生成器，整局只初始化一次
+    seed = newSeed;
+    random.Seed(seed);
+
+    // 生成食物
+    for (int i = 0; i < config.numOfFood; ++i)
+    {
+        GenerateFood(i);
+    }
+    // 设置初始方向为向右
+    currentDirection = RIGHT;
+}
+
+inline void SnakeEngine::InsertFree(int x, int y)
+{
+    ++freeCount;
+    if (sparse)
+    {
+        return;
+    }
+    int cell = CellIndex(x, y);
+    freePos[cell] = freeCells.size();
+    freeCells.push_back(cell);
+}
+
+inline void SnakeEngine::EraseFree(int x, int y)
+{
+    if (sparse)
+    {
+        // 稀疏地图按画面判断，调用方在修改画面之前调用
+        freeCount -= IsFree(x, y);
+        return;
+    }
+    int cell = CellIndex(x, y);
+    int pos = freePos[cell];
+    if (pos < 0)
+    {
+        return;
+    }
+    // 用最后一个元素填补空位
+    int last = freeCells.back();
+    freeCells[pos] = last;
+    freePos[last] = pos;
+    freeCells.pop_back();
+    freePos[cell] = -1;
+    --freeCount;
+}
+
+inline Point SnakeEngine::PickFreeCell()
+{
+    // 随机取格子直到取到空闲格子，空闲格子占多数时几次就能取到
+    const int MAX_ATTEMPTS = 64;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+    {
+        int x = 1 + random.NextBounded(map.width);
+        int y = 1 + random.NextBounded(map.height);
+        if (IsFree(x, y))
+        {
+            return {x, y};
+        }
+    }
+
+    // 地图几乎被占满时按行扫描，取第 k 个空闲格子
+    int k = random.NextBounded(freeCount);
+    for (int y = 1; y <= map.height; ++y)
+    {
+        for (int x = 1; x <= map.width; ++x)
+        {
+            if (IsFree(x, y) && k-- == 0)
+            {
+                return {x, y};
+            }
+        }
+    }
+    return {-1, -1};
+}
+
+inline void SnakeEngine::GrowSnake()
+{
+    vector<Point> grown(snake.size() * 2);
+    for (int i = 0; i < snakeLength; ++i)
+    {
+        grown[i] = snake[BodyIndex(i)];
+    }
+    snake.swap(grown);
+    headIndex = 0;
+}
+
+inline void SnakeEngine::GenerateFood(int i)
+{
+    // 没有空闲格子时该食物不再出现，所有食物都被吃完说明蛇已占满地图，游戏胜利
+    if (freeCount == 0)
+    {
+        food[i] = {-1, -1, 0};
+        for (int j = 0; j < config.numOfFood; ++j)
+        {
+            if (food[j].value != 0)
+            {
+                return;
+            }
+        }
+        gameWon = true;
+        gameOver = true;
+        endReason = END_WIN;
+        return;
+    }
+
+    // 从空闲格子中随机选择一个，食物不会生成在蛇身、障碍物或其他食物上
+    Point cell;
+    if (sparse)
+    {
+        cell = PickFreeCell();
+    }
+    else
+    {
+        int index = freeCells[random.NextBounded(freeCells.size())];
+        cell = {index % (map.width + 2), index / (map.width + 2)};
+    }
+    EraseFree(cell.x, cell.y);
+    food[i].x = cell.x;
+    food[i].y = cell.y;
+
+    // 根据概率生成不同分数的食物
+    double randValue = random.NextDouble();
+    if (randValue < config.foodProb[0])
+    {
+        food[i].value = 1;
+        Draw(food[i].x, food[i].y, '1');
+    }
+    else if (randValue < config.foodProb[0] + config.foodProb[1])
+    {
+        food[i].value = 2;
+        Draw(food[i].x, food[i].y, '2');
+    }
+    else
+    {
+        food[i].value = 3;
+        Draw(food[i].x, food[i].y, '3');
+    }
+}
+
+inline void SnakeEngine::RespawnFood(int i)
+{
+    if (food[i].value != 0)
+    {
+        Draw(food[i].x, food[i].y, '0');
+        InsertFree(food[i].x, food[i].y);
+    }
+    GenerateFood(i);
+}
+
+inline bool SnakeEngine::Step(Direction direction)
+{
+    if (gameOver)
+    {
+        return false;
+    }
+    ++ticks;
+
+    // 蛇不能直接掉头
+    if (!IsOpposite(direction, currentDirection))
+    {
+        currentDirection = direction;
+    }
+
+    // 蛇头即将移动到的位置
+    snakeHead = snake[headIndex];
+
+    // 根据方向移动蛇头
+    switch (currentDirection)
+    {
+    case UP:
+        snakeHead.y--;
+        break;
+    case DOWN:
+        snakeHead.y++;
+        break;
+    case LEFT:
+        snakeHead.x--;
+        break;
+    case RIGHT:
+        snakeHead.x++;
+        break;
+    }
+
+    // 判断蛇头是否撞到实边界，如果是则游戏结束
+    if (board.At(snakeHead.x, snakeHead.y).flags & CELL_WALL)
+    {
+        gameOver = true;
+        endReason = END_WALL;
+        return false;
+    }
+
+    // 虚边界则从另一侧穿出
+    if (snakeHead.y == 0)
+    {
+        snakeHead.y = map.height;
+    }
+    else if (snakeHead.y == map.height + 1)
+    {
+        snakeHead.y = 1;
+    }
+    if (snakeHead.x == 0)
+    {
+        snakeHead.x = map.width;
+    }
+    else if (snakeHead.x == map.width + 1)
+    {
+        snakeHead.x = 1;
+    }
+
+    // 判断蛇头是否撞到障碍物或蛇身，如果是则游戏结束
+    // 蛇尾会在本格移走，所以撞到蛇尾不算
+    unsigned char cell = board.At(snakeHead.x, snakeHead.y).flags;
+    Point tail = snake[BodyIndex(snakeLength - 1)];
+    if ((cell & CELL_OBSTACLE) ||
+        ((cell & CELL_BODY) && !(snakeHead.x == tail.x && snakeHead.y == tail.y)))
+    {
+        gameOver = true;
+        endReason = (cell & CELL_OBSTACLE) ? END_OBSTACLE : END_SELF;
+        return false;
+    }
+
+    // 缓冲区已满时扩容，保证蛇头的新槽位不会覆盖蛇尾，吃到食物时还能还原蛇尾
+    if (snakeLength >= (int)snake.size())
+    {
+        GrowSnake();
+    }
+
+    // 移动蛇，蛇头前移一个槽位，蛇尾随长度不变自然出队，蛇身其余部分不动
+    int capacity = snake.size();
+    if (Unmark(tail.x, tail.y, CELL_BODY) == 0)
+    {
+        InsertFree(tail.x, tail.y);
+    }
+
+    headIndex = (headIndex + capacity - 1) % capacity;
+    snake[headIndex] = snakeHead;
+
+    EraseFree(snakeHead.x, snakeHead.y);
+    Mark(snakeHead.x, snakeHead.y, '#', CELL_BODY);
+    if (snakeLength > 1)
+    {
+        Point neck = snake[BodyIndex(1)];
+        Draw(neck.x, neck.y, '*');
+    }
+
+    // 判断蛇头是否吃到食物，如果是则加分并生成新的食物
+    for (int i = 0; i < config.numOfFood; ++i)
+    {
+        if (snakeHead.x == food[i].x && snakeHead.y == food[i].y)
+        {
+            score += food[i].value;
+            // 还原蛇尾，蛇尾仍在原槽位，长度加 1 即可
+            snakeLength++;
+            EraseFree(tail.x, tail.y);
+            Mark(tail.x, tail.y, '*', CELL_BODY);
+            GenerateFood(i);
+        }
+    }
+    return !gameOver;
+}
+
+#endif
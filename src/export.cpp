@@ -0,0 +1,388 @@
+/*Snake Game - Record Exporter
+2023.12
+离线导出记录：把 .rec 记录逐帧推演或解码，导出为 asciicast v2 文件，或者带时间文件的 ANSI 字节流
+每帧用与游戏相同的颜色和差分渲染器只生成变化的格子并立即写出，内存占用与局长无关
+用法：export [--ansi] [--speed N] [--size CxR] <record> <output>
+asciicast 文件可以用 asciinema play 播放；ANSI 字节流的时间写入 <output>.timing，可以用 scriptreplay -t <output>.timing <output> 播放
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+
+#include "engine.h"
+#include "record.h"
+#include "render.h"
+
+using namespace std;
+
+// 默认的终端列数和行数，与游戏中无法获取终端大小时相同
+const int EXPORT_TERMINAL_COLUMNS = 80;
+const int EXPORT_TERMINAL_ROWS = 24;
+
+// 导出参数
+struct ExportOptions
+{
+    // 输出带时间文件的 ANSI 字节流，否则输出 asciicast v2 文件
+    bool ansi = false;
+    // 播放速度，为正常速度 1000 / gameDifficulty 毫秒一帧的倍数
+    double speed = 1;
+    // 终端的列数和行数，画面放不下时只导出视口，视口跟随蛇头
+    int columns = EXPORT_TERMINAL_COLUMNS;
+    int rows = EXPORT_TERMINAL_ROWS;
+    string recordPath;
+    string outputPath;
+};
+
+// 把文字写成 JSON 字符串，控制字符转义为 \u00XX，其余字节原样写出
+void WriteJsonString(ostream &output, const string &text)
+{
+    output << '"';
+    for (unsigned char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+        {
+            output << '\\' << ch;
+        }
+        else if (ch < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            output << escaped;
+        }
+        else
+        {
+            output << ch;
+        }
+    }
+    output << '"';
+}
+
+// 逐帧导出：每帧画出视口和分数等文字，差分后写出一条带时间的输出
+class RecordExporter
+{
+private:
+    ExportOptions options;
+    TerminalRenderer renderer;
+    ofstream output;
+    ofstream timing;
+
+    // 画面（含边框）大小、视口大小和位置，视口位置为 -1 时在第一帧以蛇头为中心
+    int columns = 0;
+    int rows = 0;
+    int viewWidth = 0;
+    int viewHeight = 0;
+    int viewX = -1;
+    int viewY = -1;
+    // 终端宽度，整个导出过程中不变，避免尺寸变化导致整帧重绘
+    int width = 0;
+    string configPath;
+    string mapPath;
+
+    // 每帧的时长和上一帧的时间点，秒
+    double frameSeconds = 0;
+    double lastTime = 0;
+    long long frames = 0;
+    unsigned long long bytes = 0;
+
+public:
+    explicit RecordExporter(const ExportOptions &exportOptions) : options(exportOptions) {}
+
+    // 打开输出文件并写入文件头，画面大小不含画面下方的文字
+    bool Begin(int screenColumns, int screenRows, int gameDifficulty, const string &recordConfigPath, const string &recordMapPath)
+    {
+        columns = screenColumns;
+        rows = screenRows;
+        // 下方留出分数、配置、地图、视口位置四行文字和光标一行
+        viewWidth = min(columns, max(options.columns, 3));
+        viewHeight = min(rows, max(options.rows - 5, 3));
+        configPath = recordConfigPath;
+        mapPath = recordMapPath;
+        frameSeconds = 1.0 / (max(gameDifficulty, 1) * options.speed);
+
+        // 分数按 10 位、视口位置按最大的坐标留出宽度
+        bool viewed = viewWidth < columns || viewHeight < rows;
+        string widest = to_string(max(columns, rows));
+        width = viewWidth;
+        for (const string &line : {string("Game over! Your score is 0000000000"), "Config: " + configPath, "Map: " + mapPath,
+                                   viewed ? "View: x " + widest + "-" + widest + ", y " + widest + "-" + widest + " of " + widest + "x" + widest : string()})
+        {
+            width = max(width, (int)line.size());
+        }
+        // 文字下方还有一行放光标
+        int height = viewHeight + (viewed ? 4 : 3) + 1;
+
+        output.open(options.outputPath, ios::binary);
+        if (!output)
+        {
+            return false;
+        }
+        if (options.ansi)
+        {
+            // scriptreplay 跳过第一行，与 script 命令一样写一行说明
+            timing.open(options.outputPath + ".timing");
+            if (!timing)
+            {
+                return false;
+            }
+            output << "Script started, record " << options.recordPath << ", " << width << "x" << height << "\n";
+        }
+        else
+        {
+            output << "{\"version\": 2, \"width\": " << width << ", \"height\": " << height
+                   << ", \"timestamp\": " << time(nullptr) << ", \"title\": ";
+            WriteJsonString(output, options.recordPath);
+            output << "}\n";
+        }
+        return static_cast<bool>(output);
+    }
+
+    // 导出一帧，at(x, y) 为画面中 (x, y) 处的字符，head 为蛇头位置，没有时视口停在左上角
+    template <class ScreenAt>
+    bool AddFrame(ScreenAt at, int score, bool gameOver, Point head)
+    {
+        // 与游戏中相同的视口跟随规则和绘制函数
+        if (head.x < 0)
+        {
+            viewX = 0;
+            viewY = 0;
+        }
+        else
+        {
+            FollowTarget(viewX, viewY, head.x, head.y, viewWidth, viewHeight, columns, rows);
+        }
+
+        vector<string> lines;
+        lines.push_back(!gameOver ? "Current score: " + to_string(score) : "Game over! Your score is " + to_string(score));
+        lines.push_back("Config: " + configPath);
+        lines.push_back("Map: " + mapPath);
+        if (viewWidth < columns || viewHeight < rows)
+        {
+            lines.push_back(ViewportText(viewX, viewY, viewWidth, viewHeight, columns, rows));
+        }
+
+        // 只写出与上一帧不同的部分
+        const string &data = RenderScreen(renderer, at, gameOver, viewX, viewY, viewWidth, viewHeight, lines, width);
+        double now = frames * frameSeconds;
+        if (options.ansi)
+        {
+            char line[64];
+            snprintf(line, sizeof(line), "%.6f %zu\n", now - lastTime, data.size());
+            timing << line;
+            output.write(data.data(), data.size());
+        }
+        else
+        {
+            char event[32];
+            snprintf(event, sizeof(event), "[%.6f, \"o\", ", now);
+            output << event;
+            WriteJsonString(output, data);
+            output << "]\n";
+        }
+        lastTime = now;
+        ++frames;
+        bytes += data.size();
+        return static_cast<bool>(output);
+    }
+
+    bool End()
+    {
+        output.close();
+        if (options.ansi)
+        {
+            timing.close();
+            return output.good() && timing.good();
+        }
+        return output.good();
+    }
+
+    long long GetFrameCount() const { return frames; }
+    unsigned long long GetByteCount() const { return bytes; }
+    double GetDuration() const { return lastTime; }
+};
+
+// 导出二进制画面记录，按顺序每帧只解码一个增量帧
+bool ExportFrameRecord(RecordExporter &exporter, const string &recordPath)
+{
+    FrameRecordReader reader;
+    if (!reader.Open(recordPath))
+    {
+        cout << "Failed to read record file " << recordPath << endl;
+        return false;
+    }
+    const FrameRecordInfo &info = reader.GetInfo();
+    if (!exporter.Begin(info.columns, info.rows, info.gameDifficulty, info.configPath, info.mapPath))
+    {
+        return false;
+    }
+    for (long long i = 0; i < reader.GetFrameCount(); ++i)
+    {
+        if (!reader.Seek(i))
+        {
+            cout << "Record file is corrupted at frame " << i << endl;
+            return false;
+        }
+        const Grid<char> &frame = reader.GetFrame();
+        if (!exporter.AddFrame([&frame](int x, int y)
+                               { return frame.At(x, y); },
+                               reader.GetScore(i), i == reader.GetFrameCount() - 1, {-1, -1}))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 导出事件记录，由引擎按记录的方向逐格推演，视口跟随蛇头
+bool ExportEvents(RecordExporter &exporter, istream &recordFile)
+{
+    GameRecord record;
+    if (!ReadGameRecord(recordFile, record))
+    {
+        cout << "Failed to read record file." << endl;
+        return false;
+    }
+    if (!exporter.Begin(record.map.width + 2, record.map.height + 2, record.config.gameDifficulty,
+                        record.config.configPath, record.map.mapPath))
+    {
+        return false;
+    }
+
+    SnakeEngine engine;
+    engine.ResetWithSeed(record.map, record.config, record.seed);
+    Direction direction = engine.GetDirection();
+    size_t nextInput = 0;
+    for (long long tick = 0;; ++tick)
+    {
+        bool last = tick == record.ticks || engine.IsGameOver();
+        if (!exporter.AddFrame([&engine](int x, int y)
+                               { return engine.GetScreen(x, y); },
+                               engine.GetScore(), last, engine.GetSnake(0)))
+        {
+            return false;
+        }
+        if (last)
+        {
+            return true;
+        }
+        while (nextInput < record.inputs.size() && record.inputs[nextInput].tick == tick)
+        {
+            direction = record.inputs[nextInput++].direction;
+        }
+        engine.Step(direction);
+    }
+}
+
+// 导出旧版逐帧文本记录，边读边导出，文件不完整时只导出完整的帧
+bool ExportFrames(RecordExporter &exporter, istream &recordFile, const string &configPath)
+{
+    string mapPath;
+    int gameDifficulty, height, width, screenCount;
+    recordFile >> mapPath >> gameDifficulty >> height >> width >> screenCount;
+    if (!recordFile || height <= 0 || width <= 0 || !exporter.Begin(width + 2, height + 2, gameDifficulty, configPath, mapPath))
+    {
+        cout << "Failed to read record file." << endl;
+        return false;
+    }
+
+    Grid<char> screen;
+    screen.Assign(width + 2, height + 2, '0');
+    for (int i = 0; i < screenCount; ++i)
+    {
+        for (int j = 0; j <= height + 1; ++j)
+        {
+            for (int k = 0; k <= width + 1; ++k)
+            {
+                recordFile >> screen.At(k, j);
+            }
+        }
+        int score;
+        if (!(recordFile >> score))
+        {
+            break;
+        }
+        if (!exporter.AddFrame([&screen](int x, int y)
+                               { return screen.At(x, y); },
+                               score, i == screenCount - 1, {-1, -1}))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 与游戏中的回放相同，根据文件开头判断记录格式
+bool ExportRecord(RecordExporter &exporter, const string &recordPath)
+{
+    if (IsFrameRecord(recordPath))
+    {
+        return ExportFrameRecord(exporter, recordPath);
+    }
+    ifstream recordFile(recordPath);
+    if (!recordFile)
+    {
+        cout << "Record file " << recordPath << " does not exist." << endl;
+        return false;
+    }
+    string firstLine;
+    getline(recordFile, firstLine);
+    if (firstLine.compare(0, EVENT_RECORD_MAGIC.size(), EVENT_RECORD_MAGIC) == 0)
+    {
+        recordFile.seekg(0);
+        return ExportEvents(exporter, recordFile);
+    }
+    return ExportFrames(exporter, recordFile, firstLine);
+}
+
+int main(int argc, char *argv[])
+{
+    ExportOptions options;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--ansi")
+        {
+            options.ansi = true;
+        }
+        else if (arg == "--speed" && i + 1 < argc)
+        {
+            options.speed = atof(argv[++i]);
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.columns, &options.rows) != 2)
+            {
+                options.columns = 0;
+            }
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2 || options.speed <= 0 || options.columns <= 0 || options.rows <= 0)
+    {
+        cout << "Usage: export [--ansi] [--speed N] [--size CxR] <record> <output>" << endl;
+        return 1;
+    }
+    options.recordPath = paths[0];
+    options.outputPath = paths[1];
+
+    auto start = chrono::steady_clock::now();
+    RecordExporter exporter(options);
+    bool exported = ExportRecord(exporter, options.recordPath);
+    if (!exporter.End() || !exported)
+    {
+        cout << "Failed to export " << options.recordPath << " to " << options.outputPath << endl;
+        return 1;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Exported " << exporter.GetFrameCount() << " frames (" << exporter.GetDuration() << " s of playback, "
+         << exporter.GetByteCount() << " bytes of terminal output) in " << elapsed << " s" << endl;
+    return 0;
+}
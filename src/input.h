@@ -0,0 +1,155 @@
+/*Snake Game - Input
+2023.12
+游戏中的按键队列：独立的读取线程等待按键，带上单调时钟时间戳放入单生产者单消费者的无锁环形队列
+主循环每格最多应用一次方向改变，其余按键留到之后的格子，一格内快速连按的转向不再丢失
+*/
+
+#ifndef SNAKE_INPUT_H
+#define SNAKE_INPUT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "platform.h"
+
+using namespace std;
+
+// 读取线程等待按键的最长时间，毫秒，到时检查是否需要退出；按键到达时立即返回，不影响延迟
+const int INPUT_READER_WAIT_MS = 50;
+// 按键在队列中最多保留的格数，超过后丢弃，避免连按太多时之后很久还在转向
+const int INPUT_MAX_AGE_TICKS = 3;
+
+// 一次按键和读取到它的时间点，单调时钟纳秒
+struct KeyEvent
+{
+    int key;
+    long long timeNs;
+};
+
+// 单生产者单消费者的无锁环形队列，容量为 2 的幂
+// 只有生产者写 tail，只有消费者写 head，各自用 acquire 读取对方的位置，不需要锁
+template <class T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    T items[Capacity];
+    // 消费者的读取位置和生产者的写入位置，只增不减，放在不同的缓存行中
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+
+public:
+    // 生产者调用，队列满时返回 false
+    bool Push(const T &item)
+    {
+        size_t position = tail.load(memory_order_relaxed);
+        if (position - head.load(memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        items[position & (Capacity - 1)] = item;
+        tail.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    // 消费者调用，队列空时返回 false
+    bool Pop(T &item)
+    {
+        size_t position = head.load(memory_order_relaxed);
+        if (position == tail.load(memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[position & (Capacity - 1)];
+        head.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    bool Empty() const { return head.load(memory_order_acquire) == tail.load(memory_order_acquire); }
+};
+
+// 游戏中的按键读取线程，Start 到 Stop 之间终端按键只从这里读取
+class InputReader
+{
+private:
+    SpscQueue<KeyEvent, 256> queue;
+    thread reader;
+    atomic<bool> running{false};
+    // 只用于让等待按键的主线程休眠，队列本身不加锁
+    mutex wakeMutex;
+    condition_variable wake;
+
+    void ReadLoop()
+    {
+        while (running.load(memory_order_acquire))
+        {
+            int key = WaitKey(INPUT_READER_WAIT_MS);
+            if (key == 0)
+            {
+                continue;
+            }
+            // 队列满时丢弃按键，主线程每格都会取出按键，正常游戏中不会满
+            if (queue.Push({key, MonotonicNs()}))
+            {
+                // 加锁再通知，保证主线程检查队列和开始等待之间不会漏掉通知
+                {
+                    lock_guard<mutex> lock(wakeMutex);
+                }
+                wake.notify_one();
+            }
+        }
+    }
+
+public:
+    InputReader() {}
+    InputReader(const InputReader &) = delete;
+    InputReader &operator=(const InputReader &) = delete;
+    ~InputReader() { Stop(); }
+
+    // 启动读取线程，调用前终端应已进入原始模式
+    void Start()
+    {
+        if (running.exchange(true))
+        {
+            return;
+        }
+        reader = thread(&InputReader::ReadLoop, this);
+    }
+
+    // 停止读取线程，最多等待 INPUT_READER_WAIT_MS 毫秒；队列中剩下的按键被丢弃
+    void Stop()
+    {
+        if (!running.exchange(false))
+        {
+            return;
+        }
+        reader.join();
+        KeyEvent event;
+        while (queue.Pop(event))
+        {
+        }
+    }
+
+    // 取出最早的按键，没有按键时返回 false
+    bool Pop(KeyEvent &event) { return queue.Pop(event); }
+
+    // 休眠直到有按键，不占用 CPU，返回最早的按键
+    KeyEvent WaitPop()
+    {
+        KeyEvent event;
+        while (!queue.Pop(event))
+        {
+            unique_lock<mutex> lock(wakeMutex);
+            wake.wait(lock, [this]
+                      { return !queue.Empty(); });
+        }
+        return event;
+    }
+};
+
+#endif
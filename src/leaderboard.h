@@ -0,0 +1,757 @@
+/*Snake Game - Leaderboard
+2023.12
+排行榜存储：只追加的二进制记录日志加上持久化的分数索引，添加一条记录只在两个文件末尾各追加一段数据，不重写文件
+打开时从索引建立按分数排序的结构和分数计数的树状数组，前 K 名只读取 K 条记录，某个分数的名次不需要扫描全部记录
+多个进程同时写入时用锁文件上的建议性锁互斥，持锁时间只有追加两小段数据，不需要重写文件
+索引项还带有地图、配置的哈希和日期，内存中据此建立按地图、按配置的分数索引和按日期的索引，筛选查询不需要解析日志
+*/
+
+#ifndef SNAKE_LEADERBOARD_H
+#define SNAKE_LEADERBOARD_H
+
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+
+#include "record.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/file.h>
+#endif
+
+using namespace std;
+
+struct LeaderboardEntry
+{
+    string name;
+    int score;
+    string date;
+    string time;
+    string configPath;
+    string mapPath;
+};
+
+// 排行榜查询的筛选条件
+struct LeaderboardFilter
+{
+    // 为空时不限
+    string mapPath;
+    string configPath;
+    // 日期范围 [dateFrom, dateTo]，格式为 yyyymmdd，0 表示不限
+    int dateFrom = 0;
+    int dateTo = 0;
+};
+
+// 记录日志和索引的文件头：4 字节标识和 4 字节版本号
+// 索引版本不同时从日志重建索引，日志格式不变
+const char LEADERBOARD_LOG_MAGIC[4] = {'S', 'N', 'K', 'L'};
+const char LEADERBOARD_INDEX_MAGIC[4] = {'S', 'N', 'K', 'I'};
+const uint32_t LEADERBOARD_LOG_VERSION = 1;
+const uint32_t LEADERBOARD_INDEX_VERSION = 2;
+const int LEADERBOARD_HEADER_SIZE = 8;
+// 索引项：分数、日期、地图路径哈希、配置路径哈希、记录在日志中的位置
+const int LEADERBOARD_INDEX_ENTRY_SIZE = 24;
+// 排行榜界面显示的名次数
+const int LEADERBOARD_DISPLAY_COUNT = 20;
+// 旧版文本排行榜的第一行
+const string LEADERBOARD_TEXT_HEADER = "Name Score Date Time Configuration Map";
+
+// 路径的 32 位 FNV-1a 哈希，用于索引；哈希相同的不同路径在读取记录时再比较字符串
+inline uint32_t HashPath(const string &path)
+{
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : path)
+    {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// 把 yyyy/m/d 格式的日期转换为 yyyymmdd，格式不对时返回 0
+inline int ParseDate(const string &date)
+{
+    int year, month, day;
+    if (sscanf(date.c_str(), "%d/%d/%d", &year, &month, &day) != 3)
+    {
+        return 0;
+    }
+    return year * 10000 + month * 100 + day;
+}
+
+// daysAgo 天前的本地日期，格式为 yyyymmdd
+inline int DateDaysAgo(int daysAgo)
+{
+    time_t now = time(0);
+    tm date = *localtime(&now);
+    date.tm_mday -= daysAgo;
+    date.tm_isdst = -1;
+    // mktime 会把超出范围的日期规范化，例如 12 月 0 日变为 11 月 30 日
+    mktime(&date);
+    return (1900 + date.tm_year) * 10000 + (1 + date.tm_mon) * 100 + date.tm_mday;
+}
+
+// 建议性文件锁，构造时阻塞直到独占锁文件，析构时释放
+// 锁加在单独的锁文件上：Windows 的 LockFileEx 会阻止其他进程读取被锁的区域，不能直接锁日志
+class FileLock
+{
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool locked = false;
+
+public:
+    explicit FileLock(const string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            OVERLAPPED overlapped = {};
+            locked = LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped) != 0;
+        }
+#else
+        fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd >= 0)
+        {
+            int result;
+            while ((result = flock(fd, LOCK_EX)) != 0 && errno == EINTR)
+            {
+            }
+            locked = result == 0;
+        }
+#endif
+    }
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+
+    ~FileLock()
+    {
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            if (locked)
+            {
+                OVERLAPPED overlapped = {};
+                UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &overlapped);
+            }
+            CloseHandle(file);
+        }
+#else
+        if (fd >= 0)
+        {
+            // 关闭文件描述符时锁随之释放
+            close(fd);
+        }
+#endif
+    }
+
+    bool IsLocked() const { return locked; }
+};
+
+// 排行榜存储
+// 索引按加入顺序保存每条记录的分数、日期、地图和配置路径的哈希以及位置，打开时读入内存，不需要解析日志
+// 内存中按分数分桶，另有按地图、按配置的分数索引和按日期的索引，打开百万条记录的排行榜约 0.4 秒，筛选查询在毫秒以内
+// 多个进程可以同时写同一个排行榜：写入方持有锁文件的独占锁，先读入其他进程追加的索引项，再在末尾追加
+class Leaderboard
+{
+private:
+    // 一条记录的索引项，不需要读日志就能判断是否满足筛选条件
+    struct IndexItem
+    {
+        int score;
+        // yyyymmdd，日期格式不对时为 0
+        int date;
+        uint32_t mapHash;
+        uint32_t configHash;
+        uint64_t offset;
+    };
+
+    // 分桶索引：每个键一个桶，桶内是记录编号，按加入的先后；keys 按 Compare 的顺序保存所有出现过的键
+    // 桶用哈希表，加入记录只有一次哈希查找，只有出现新的键时才插入有序的 keys，打开大排行榜时比平衡树快得多
+    template <class Compare>
+    struct BucketIndex
+    {
+        unordered_map<int, vector<uint32_t>> buckets;
+        vector<int> keys;
+        size_t count = 0;
+
+        void Add(int key, uint32_t id)
+        {
+            vector<uint32_t> &bucket = buckets[key];
+            if (bucket.empty())
+            {
+                keys.insert(lower_bound(keys.begin(), keys.end(), key, Compare()), key);
+            }
+            bucket.push_back(id);
+            ++count;
+        }
+
+        const vector<uint32_t> &Bucket(int key) const { return buckets.find(key)->second; }
+    };
+    // 按分数从高到低
+    typedef BucketIndex<greater<int>> ScoreIndex;
+    // 按日期从早到晚
+    typedef BucketIndex<less<int>> DateIndex;
+
+    string logPath;
+    string indexPath;
+    // 写入方之间互斥用的锁文件，读取记录不需要加锁
+    string lockPath;
+    // 最近一次操作失败的原因，由调用方决定是否输出
+    string error;
+    // 所有记录的索引项，下标为记录编号，即加入的顺序
+    vector<IndexItem> items;
+    // 全部记录的分数索引
+    ScoreIndex byScore;
+    // 按地图路径哈希、配置路径哈希分开的分数索引
+    unordered_map<uint32_t, ScoreIndex> byMap;
+    unordered_map<uint32_t, ScoreIndex> byConfig;
+    // 按日期分桶的记录编号
+    DateIndex byDate;
+    // 下标为分数加一的树状数组，用来求高于某个分数的记录数
+    vector<int> fenwick;
+    // 已建立索引的日志长度
+    uint64_t indexedSize = 0;
+
+    static string EncodeEntry(const LeaderboardEntry &entry)
+    {
+        string payload;
+        PutU32(payload, static_cast<uint32_t>(entry.score));
+        for (const string *field : {&entry.name, &entry.date, &entry.time, &entry.configPath, &entry.mapPath})
+        {
+            PutVarint(payload, field->size());
+            payload += *field;
+        }
+        string record;
+        PutU32(record, payload.size());
+        return record + payload;
+    }
+
+    static bool DecodeEntry(const unsigned char *data, const unsigned char *end, LeaderboardEntry &entry)
+    {
+        if (end - data < 4)
+        {
+            return false;
+        }
+        entry.score = static_cast<int>(GetU32(data));
+        data += 4;
+        for (string *field : {&entry.name, &entry.date, &entry.time, &entry.configPath, &entry.mapPath})
+        {
+            uint32_t length;
+            if (!GetVarint(data, end, length) || end - data < length)
+            {
+                return false;
+            }
+            field->assign(reinterpret_cast<const char *>(data), length);
+            data += length;
+        }
+        return true;
+    }
+
+    static IndexItem MakeIndexItem(const LeaderboardEntry &entry, uint64_t offset)
+    {
+        return {entry.score, ParseDate(entry.date), HashPath(entry.mapPath), HashPath(entry.configPath), offset};
+    }
+
+    static string EncodeIndexItem(const IndexItem &item)
+    {
+        string buffer;
+        PutU32(buffer, static_cast<uint32_t>(item.score));
+        PutU32(buffer, static_cast<uint32_t>(item.date));
+        PutU32(buffer, item.mapHash);
+        PutU32(buffer, item.configHash);
+        PutU64(buffer, item.offset);
+        return buffer;
+    }
+
+    static string Header(const char *magic, uint32_t version)
+    {
+        string header(magic, 4);
+        PutU32(header, version);
+        return header;
+    }
+
+    // 检查文件头，文件不存在、太短或版本不同时返回 false
+    static bool CheckHeader(const string &path, const char *magic, uint32_t version)
+    {
+        ifstream file(path, ios::binary);
+        unsigned char header[LEADERBOARD_HEADER_SIZE];
+        if (!file.read(reinterpret_cast<char *>(header), LEADERBOARD_HEADER_SIZE))
+        {
+            return false;
+        }
+        return memcmp(header, magic, 4) == 0 && GetU32(header + 4) == version;
+    }
+
+    // 读取日志中 offset 处的记录，返回下一条记录的位置，记录不完整时返回 0
+    static uint64_t ReadRecord(ifstream &log, uint64_t offset, LeaderboardEntry &entry)
+    {
+        unsigned char lengthBytes[4];
+        log.clear();
+        log.seekg(offset);
+        if (!log.read(reinterpret_cast<char *>(lengthBytes), 4))
+        {
+            return 0;
+        }
+        uint32_t length = GetU32(lengthBytes);
+        vector<unsigned char> payload(length);
+        if (!log.read(reinterpret_cast<char *>(payload.data()), length) ||
+            !DecodeEntry(payload.data(), payload.data() + length, entry))
+        {
+            return 0;
+        }
+        return offset + 4 + length;
+    }
+
+    // offset 处读不出的记录是否越过了日志末尾，即写到一半的最后一条记录；否则是日志中间的损坏
+    static bool IsTornTail(ifstream &log, uint64_t offset, uint64_t logSize)
+    {
+        unsigned char lengthBytes[4];
+        if (logSize - offset < 4)
+        {
+            return true;
+        }
+        log.clear();
+        log.seekg(offset);
+        if (!log.read(reinterpret_cast<char *>(lengthBytes), 4))
+        {
+            return true;
+        }
+        return GetU32(lengthBytes) > logSize - offset - 4;
+    }
+
+    // 负分按 0 计
+    static int FenwickIndex(int score) { return (score < 0 ? 0 : score) + 1; }
+
+    void AddToFenwick(int score, int count)
+    {
+        for (int i = FenwickIndex(score); i < (int)fenwick.size(); i += i & -i)
+        {
+            fenwick[i] += count;
+        }
+    }
+
+    // 把一条已写入日志的记录加入内存中的各个索引
+    void Insert(const IndexItem &item)
+    {
+        uint32_t id = items.size();
+        int score = item.score;
+        items.push_back(item);
+        byScore.Add(score, id);
+        byMap[item.mapHash].Add(score, id);
+        byConfig[item.configHash].Add(score, id);
+        byDate.Add(item.date, id);
+        if (FenwickIndex(score) < (int)fenwick.size())
+        {
+            AddToFenwick(score, 1);
+            return;
+        }
+        // 分数超出树状数组的范围，按两倍扩大后由 byScore 重建，byScore 已包含这一条
+        size_t size = fenwick.size() < 64 ? 64 : fenwick.size();
+        while ((int)size <= FenwickIndex(score))
+        {
+            size *= 2;
+        }
+        fenwick.assign(size, 0);
+        for (const auto &bucket : byScore.buckets)
+        {
+            AddToFenwick(bucket.first, bucket.second.size());
+        }
+    }
+
+    // 分数不高于 score 的记录数
+    int CountAtMost(int score) const
+    {
+        int count = 0;
+        int index = FenwickIndex(score);
+        if (index >= (int)fenwick.size())
+        {
+            index = fenwick.size() - 1;
+        }
+        for (int i = index; i > 0; i -= i & -i)
+        {
+            count += fenwick[i];
+        }
+        return count;
+    }
+
+    void Clear()
+    {
+        items.clear();
+        byScore = ScoreIndex();
+        byMap.clear();
+        byConfig.clear();
+        byDate = DateIndex();
+        fenwick.clear();
+        indexedSize = LEADERBOARD_HEADER_SIZE;
+    }
+
+    // 清空内存中的索引，索引文件只保留文件头，之后由 CatchUp 从日志重建
+    void ResetIndex()
+    {
+        Clear();
+        ofstream index(indexPath, ios::binary | ios::trunc);
+        string header = Header(LEADERBOARD_INDEX_MAGIC, LEADERBOARD_INDEX_VERSION);
+        index.write(header.data(), header.size());
+    }
+
+    // 记录是否满足筛选条件中除字符串比较以外的部分，mapHash 和 configHash 为筛选条件中路径的哈希
+    static bool Matches(const IndexItem &item, const LeaderboardFilter &filter, uint32_t mapHash, uint32_t configHash)
+    {
+        return (filter.mapPath.empty() || item.mapHash == mapHash) &&
+               (filter.configPath.empty() || item.configHash == configHash) &&
+               (filter.dateFrom == 0 || item.date >= filter.dateFrom) &&
+               (filter.dateTo == 0 || item.date <= filter.dateTo);
+    }
+
+    // 读入索引文件中还没有读过的项，包括其他进程追加的，并求出已建立索引的日志长度，索引文件无效时返回 false
+    bool LoadIndex(ifstream &log)
+    {
+        if (!CheckHeader(indexPath, LEADERBOARD_INDEX_MAGIC, LEADERBOARD_INDEX_VERSION))
+        {
+            return false;
+        }
+        uint64_t size = filesystem::file_size(indexPath) - LEADERBOARD_HEADER_SIZE;
+        if (size % LEADERBOARD_INDEX_ENTRY_SIZE != 0 || size / LEADERBOARD_INDEX_ENTRY_SIZE < items.size())
+        {
+            // 最后一项没有写完整，或者索引被截短了
+            return false;
+        }
+        size_t count = size / LEADERBOARD_INDEX_ENTRY_SIZE - items.size();
+        if (count == 0)
+        {
+            return true;
+        }
+
+        vector<unsigned char> data(count * LEADERBOARD_INDEX_ENTRY_SIZE);
+        ifstream index(indexPath, ios::binary);
+        index.seekg(LEADERBOARD_HEADER_SIZE + (uint64_t)items.size() * LEADERBOARD_INDEX_ENTRY_SIZE);
+        if (!index.read(reinterpret_cast<char *>(data.data()), data.size()))
+        {
+            return false;
+        }
+        // 新读入的第一项必须紧接着已知的最后一条记录，之后的位置递增
+        uint64_t lastOffset = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const unsigned char *bytes = data.data() + i * LEADERBOARD_INDEX_ENTRY_SIZE;
+            IndexItem item = {static_cast<int>(GetU32(bytes)), static_cast<int>(GetU32(bytes + 4)), GetU32(bytes + 8), GetU32(bytes + 12), GetU64(bytes + 16)};
+            if (i == 0 ? item.offset != indexedSize : item.offset <= lastOffset)
+            {
+                return false;
+            }
+            Insert(item);
+            lastOffset = item.offset;
+        }
+        // 索引只记录位置，最后一条记录的结尾要读一次日志
+        LeaderboardEntry entry;
+        indexedSize = ReadRecord(log, lastOffset, entry);
+        return indexedSize != 0;
+    }
+
+    // 索引落后于日志时，把日志末尾还没有索引的记录补进索引，越过文件末尾的最后一条记录截掉
+    // 写入方在持有锁时才会写日志，所以持锁时日志末尾不完整的记录只可能是崩溃留下的
+    // 完整但无法解析的记录说明日志中间损坏，这时不修改任何文件，返回 false，留给用户处理
+    bool CatchUp(ifstream &log)
+    {
+        uint64_t logSize = filesystem::file_size(logPath);
+        string pending;
+        uint64_t offset = indexedSize;
+        while (offset < logSize)
+        {
+            LeaderboardEntry entry;
+            uint64_t next = ReadRecord(log, offset, entry);
+            if (next == 0)
+            {
+                if (!IsTornTail(log, offset, logSize))
+                {
+                    error = logPath + " is corrupted at offset " + to_string(offset) + ".";
+                    return false;
+                }
+                break;
+            }
+            IndexItem item = MakeIndexItem(entry, offset);
+            Insert(item);
+            pending += EncodeIndexItem(item);
+            offset = next;
+        }
+        log.close();
+        if (offset < logSize)
+        {
+            filesystem::resize_file(logPath, offset);
+        }
+        indexedSize = offset;
+        if (pending.empty())
+        {
+            return true;
+        }
+        ofstream index(indexPath, ios::binary | ios::app);
+        index.write(pending.data(), pending.size());
+        return static_cast<bool>(index);
+    }
+
+    // 持锁时调用：读入其他进程追加的索引项，再补上日志中没有索引的记录
+    bool Sync()
+    {
+        ifstream log(logPath, ios::binary);
+        if (!LoadIndex(log))
+        {
+            // 索引损坏或与日志不一致，从日志重建
+            ResetIndex();
+        }
+        return CatchUp(log);
+    }
+
+    // 持锁时调用：一批记录一次写入日志，再一次写入索引，中途退出时下次持锁会从日志补上索引
+    bool AppendLocked(const vector<LeaderboardEntry> &entries)
+    {
+        string records;
+        string indexEntries;
+        vector<IndexItem> newItems;
+        uint64_t offset = indexedSize;
+        for (const LeaderboardEntry &entry : entries)
+        {
+            string record = EncodeEntry(entry);
+            newItems.push_back(MakeIndexItem(entry, offset));
+            indexEntries += EncodeIndexItem(newItems.back());
+            offset += record.size();
+            records += record;
+        }
+
+        ofstream log(logPath, ios::binary | ios::app);
+        log.write(records.data(), records.size());
+        log.close();
+        if (!log)
+        {
+            return false;
+        }
+        ofstream index(indexPath, ios::binary | ios::app);
+        index.write(indexEntries.data(), indexEntries.size());
+        index.close();
+
+        for (const IndexItem &item : newItems)
+        {
+            Insert(item);
+        }
+        indexedSize = offset;
+        return static_cast<bool>(index);
+    }
+
+    // 导入旧版文本排行榜
+    bool ImportText(const string &textPath)
+    {
+        ifstream textFile(textPath);
+        string line;
+        vector<LeaderboardEntry> entries;
+        while (getline(textFile, line))
+        {
+            if (line == LEADERBOARD_TEXT_HEADER || line.empty())
+            {
+                continue;
+            }
+            stringstream ss(line);
+            LeaderboardEntry entry;
+            if (ss >> entry.name >> entry.score >> entry.date >> entry.time >> entry.configPath >> entry.mapPath)
+            {
+                entries.push_back(entry);
+            }
+        }
+        return AppendLocked(entries);
+    }
+
+public:
+    // 打开 directory 下的排行榜，文件不存在时创建；只有旧版文本排行榜时导入它，文本文件保持不变
+    bool Open(const string &directory = "leaderboard")
+    {
+        Clear();
+        error.clear();
+        filesystem::create_directories(directory);
+        logPath = directory + "/leaderboard.log";
+        indexPath = directory + "/leaderboard.idx";
+        lockPath = directory + "/leaderboard.lock";
+        string textPath = directory + "/leaderboard.txt";
+
+        // 创建文件、导入和截掉不完整的记录都要在持锁时进行
+        FileLock lock(lockPath);
+        if (!lock.IsLocked())
+        {
+            error = "Failed to lock " + lockPath + ".";
+            return false;
+        }
+        bool importText = false;
+        if (!CheckHeader(logPath, LEADERBOARD_LOG_MAGIC, LEADERBOARD_LOG_VERSION))
+        {
+            if (filesystem::exists(logPath) && filesystem::file_size(logPath) > 0)
+            {
+                error = logPath + " is not a leaderboard log.";
+                return false;
+            }
+            ofstream log(logPath, ios::binary | ios::trunc);
+            string header = Header(LEADERBOARD_LOG_MAGIC, LEADERBOARD_LOG_VERSION);
+            log.write(header.data(), header.size());
+            log.close();
+            ResetIndex();
+            importText = filesystem::exists(textPath);
+        }
+        if (!Sync())
+        {
+            if (error.empty())
+            {
+                error = "Failed to read " + logPath + ".";
+            }
+            return false;
+        }
+        if (importText && !ImportText(textPath))
+        {
+            error = "Failed to import " + textPath + ".";
+            return false;
+        }
+        return true;
+    }
+
+    // 最近一次 Open、Append 或 Refresh 失败的原因，可能为空
+    const string &GetError() const { return error; }
+
+    // 追加一批记录：持锁期间先读入其他进程的新记录，日志末尾就是新记录的位置
+    bool Append(const vector<LeaderboardEntry> &entries)
+    {
+        error.clear();
+        FileLock lock(lockPath);
+        return lock.IsLocked() && Sync() && AppendLocked(entries);
+    }
+
+    // 读入其他进程在本次打开之后加入的记录
+    bool Refresh()
+    {
+        error.clear();
+        FileLock lock(lockPath);
+        return lock.IsLocked() && Sync();
+    }
+
+    bool Add(const LeaderboardEntry &entry)
+    {
+        return Append({entry});
+    }
+
+    // 满足筛选条件的分数最高的 k 条记录，同分先加入的在前
+    // 有地图或配置条件时只遍历对应的分数索引；日期范围内的记录更少时改为取出日期范围内的记录再按分数排序
+    vector<LeaderboardEntry> Top(int k, const LeaderboardFilter &filter = LeaderboardFilter()) const
+    {
+        vector<LeaderboardEntry> entries;
+        ifstream log(logPath, ios::binary);
+        uint32_t mapHash = HashPath(filter.mapPath);
+        uint32_t configHash = HashPath(filter.configPath);
+        // 读取一条候选记录，比较路径字符串排除哈希冲突，返回是否已取够 k 条
+        auto accept = [&](uint32_t id)
+        {
+            LeaderboardEntry entry;
+            if ((int)entries.size() < k && Matches(items[id], filter, mapHash, configHash) && ReadRecord(log, items[id].offset, entry) != 0 &&
+                (filter.mapPath.empty() || entry.mapPath == filter.mapPath) &&
+                (filter.configPath.empty() || entry.configPath == filter.configPath))
+            {
+                entries.push_back(entry);
+            }
+            return (int)entries.size() >= k;
+        };
+
+        const ScoreIndex *index = &byScore;
+        if (!filter.mapPath.empty() || !filter.configPath.empty())
+        {
+            // 地图和配置都有条件时选记录较少的那个索引
+            const ScoreIndex *mapIndex = nullptr;
+            const ScoreIndex *configIndex = nullptr;
+            if (!filter.mapPath.empty())
+            {
+                auto it = byMap.find(mapHash);
+                if (it == byMap.end())
+                {
+                    return entries;
+                }
+                mapIndex = &it->second;
+            }
+            if (!filter.configPath.empty())
+            {
+                auto it = byConfig.find(configHash);
+                if (it == byConfig.end())
+                {
+                    return entries;
+                }
+                configIndex = &it->second;
+            }
+            index = mapIndex == nullptr || (configIndex != nullptr && configIndex->count < mapIndex->count) ? configIndex : mapIndex;
+        }
+
+        if (filter.dateFrom != 0 || filter.dateTo != 0)
+        {
+            auto first = lower_bound(byDate.keys.begin(), byDate.keys.end(), filter.dateFrom);
+            auto last = filter.dateTo == 0 ? byDate.keys.end() : upper_bound(byDate.keys.begin(), byDate.keys.end(), filter.dateTo);
+            size_t inRange = 0;
+            for (auto it = first; it != last; ++it)
+            {
+                inRange += byDate.Bucket(*it).size();
+            }
+            if (inRange < index->count)
+            {
+                vector<uint32_t> candidates;
+                for (auto it = first; it != last; ++it)
+                {
+                    for (uint32_t id : byDate.Bucket(*it))
+                    {
+                        if (Matches(items[id], filter, mapHash, configHash))
+                        {
+                            candidates.push_back(id);
+                        }
+                    }
+                }
+                sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b)
+                     { return items[a].score != items[b].score ? items[a].score > items[b].score : a < b; });
+                for (uint32_t id : candidates)
+                {
+                    if (accept(id))
+                    {
+                        break;
+                    }
+                }
+                return entries;
+            }
+        }
+
+        for (int score : index->keys)
+        {
+            for (uint32_t id : index->Bucket(score))
+            {
+                if (accept(id))
+                {
+                    return entries;
+                }
+            }
+        }
+        return entries;
+    }
+
+    // 分数 score 的名次，即高于它的记录数加一
+    int Rank(int score) const
+    {
+        return Size() - CountAtMost(score) + 1;
+    }
+
+    int Size() const { return items.size(); }
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*Snake Game - Map Converter
+2023.12
+地图格式转换：把文本地图转换成二进制地图，或者用 --text 把二进制地图转换回文本地图，并比较两种格式的大小和加载时间
+用法：mapconv [--text] <input> <output>
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#include "mapfile.h"
+
+using namespace std;
+
+// 加载地图文件，返回用时（微秒），失败时返回 -1
+double TimeLoad(const string &path, Map &map)
+{
+    auto start = chrono::steady_clock::now();
+    bool loaded = LoadMapFile(path, map);
+    auto end = chrono::steady_clock::now();
+    return loaded ? chrono::duration<double, micro>(end - start).count() : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    bool toText = false;
+    int argi = 1;
+    if (argi < argc && string(argv[argi]) == "--text")
+    {
+        toText = true;
+        ++argi;
+    }
+    if (argc - argi != 2)
+    {
+        cout << "Usage: mapconv [--text] <input> <output>" << endl;
+        return 1;
+    }
+    string input = argv[argi];
+    string output = argv[argi + 1];
+
+    Map map;
+    double inputTime = TimeLoad(input, map);
+    if (inputTime < 0)
+    {
+        cout << "Failed to load map file " << input << endl;
+        return 1;
+    }
+    bool written = toText ? WriteTextMapFile(output, map) : WriteBinaryMapFile(output, map);
+    if (!written)
+    {
+        cout << "Failed to write map file " << output << endl;
+        return 1;
+    }
+
+    Map converted;
+    double outputTime = TimeLoad(output, converted);
+    if (outputTime < 0)
+    {
+        cout << "Failed to load converted map file " << output << endl;
+        return 1;
+    }
+
+    vector<ObstacleRect> rects = BuildObstacleRects(converted);
+    long long cells = 0;
+    for (const ObstacleRect &rect : rects)
+    {
+        cells += static_cast<long long>(rect.width) * rect.height;
+    }
+    cout << "Map: " << converted.width << "x" << converted.height << ", " << cells << " obstacle cells, "
+         << rects.size() << " rectangles" << endl;
+    cout << input << ": " << filesystem::file_size(input) << " bytes, loaded in " << inputTime << " us" << endl;
+    cout << output << ": " << filesystem::file_size(output) << " bytes, loaded in " << outputTime << " us" << endl;
+    return 0;
+}
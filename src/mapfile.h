@@ -0,0 +1,185 @@
+/*Snake Game - Map File
+2023.12
+二进制地图文件：文件头之后是矩形障碍物表，每一行中连续的障碍物先合并成游程，上下相邻、起止列相同的游程再合并成矩形
+加载时内存映射整个文件，只按矩形读取，不逐格解析；文本地图仍然可以读取，LoadMapFile 根据文件开头的魔数自动选择
+*/
+
+#ifndef SNAKE_MAPFILE_H
+#define SNAKE_MAPFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine.h"
+#include "record.h"
+
+using namespace std;
+
+// 二进制地图文件
+// 文件头：魔数 SNKM、版本、宽、高、上下左右四个边界属性各一字节、矩形数
+// 之后每个矩形依次为 x、y、宽、高，都是小端序的 32 位整数
+const char MAP_FILE_MAGIC[4] = {'S', 'N', 'K', 'M'};
+const uint32_t MAP_FILE_VERSION = 1;
+const size_t MAP_FILE_HEADER_SIZE = 24;
+const size_t MAP_FILE_RECT_SIZE = 16;
+
+// 判断文件是否为二进制地图
+inline bool IsBinaryMapFile(const string &path)
+{
+    ifstream file(path, ios::binary);
+    char magic[4] = {};
+    file.read(magic, 4);
+    return file && memcmp(magic, MAP_FILE_MAGIC, 4) == 0;
+}
+
+// 把地图上的全部障碍物合并成矩形：先按行合并成游程，再把上下相邻、起止列相同的游程合并，重叠的障碍物只保留一份
+inline vector<ObstacleRect> BuildObstacleRects(const Map &map)
+{
+    vector<Point> cells;
+    ForEachObstacle(map, [&cells](int x, int y)
+                    { cells.push_back({x, y}); });
+    sort(cells.begin(), cells.end(), [](const Point &a, const Point &b)
+         { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+
+    vector<ObstacleRect> rects;
+    // 以游程的起止列为键，记录上一行结束的矩形，下一行出现相同的游程时向下延伸
+    unordered_map<uint64_t, size_t> open;
+    size_t i = 0;
+    while (i < cells.size())
+    {
+        int x = cells[i].x;
+        int y = cells[i].y;
+        int width = 1;
+        ++i;
+        while (i < cells.size() && cells[i].y == y && cells[i].x <= x + width)
+        {
+            width = max(width, cells[i].x - x + 1);
+            ++i;
+        }
+
+        uint64_t key = (static_cast<uint64_t>(x) << 32) | static_cast<uint32_t>(width);
+        auto found = open.find(key);
+        if (found != open.end() && rects[found->second].y + rects[found->second].height == y)
+        {
+            rects[found->second].height++;
+        }
+        else
+        {
+            open[key] = rects.size();
+            rects.push_back({x, y, width, 1});
+        }
+    }
+    return rects;
+}
+
+// 写入二进制地图，障碍物合并成矩形
+inline bool WriteBinaryMapFile(const string &path, const Map &map)
+{
+    vector<ObstacleRect> rects = BuildObstacleRects(map);
+    string buffer(MAP_FILE_MAGIC, 4);
+    PutU32(buffer, MAP_FILE_VERSION);
+    PutU32(buffer, map.width);
+    PutU32(buffer, map.height);
+    for (int d = 0; d < 4; ++d)
+    {
+        buffer.push_back(static_cast<char>(map.real[d]));
+    }
+    PutU32(buffer, rects.size());
+    for (const ObstacleRect &rect : rects)
+    {
+        PutU32(buffer, rect.x);
+        PutU32(buffer, rect.y);
+        PutU32(buffer, rect.width);
+        PutU32(buffer, rect.height);
+    }
+
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    return static_cast<bool>(file);
+}
+
+// 写入文本地图，矩形展开成单格障碍物，重叠的格子只写一次
+inline bool WriteTextMapFile(const string &path, const Map &map)
+{
+    ofstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    vector<ObstacleRect> rects = BuildObstacleRects(map);
+    long long count = 0;
+    for (const ObstacleRect &rect : rects)
+    {
+        count += static_cast<long long>(rect.width) * rect.height;
+    }
+    file << map.width << " " << map.height << "\n";
+    file << map.real[UP] << " " << map.real[DOWN] << " " << map.real[LEFT] << " " << map.real[RIGHT] << "\n";
+    file << count << "\n";
+    Map expanded = map;
+    expanded.numOfObstacle = 0;
+    expanded.obstacleRects = rects;
+    ForEachObstacle(expanded, [&file](int x, int y)
+                    { file << x << " " << y << "\n"; });
+    return static_cast<bool>(file);
+}
+
+// 内存映射读取二进制地图，文件不存在、版本不支持或内容越界时返回 false
+inline bool ReadBinaryMapFile(const string &path, Map &map)
+{
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < MAP_FILE_HEADER_SIZE)
+    {
+        return false;
+    }
+    const unsigned char *data = file.Data();
+    if (memcmp(data, MAP_FILE_MAGIC, 4) != 0 || GetU32(data + 4) != MAP_FILE_VERSION)
+    {
+        return false;
+    }
+    uint32_t width = GetU32(data + 8);
+    uint32_t height = GetU32(data + 12);
+    uint32_t count = GetU32(data + 20);
+    if (width < MIN_MAP_SIZE || height < MIN_MAP_SIZE || width > MAX_MAP_SIZE || height > MAX_MAP_SIZE ||
+        (file.Size() - MAP_FILE_HEADER_SIZE) / MAP_FILE_RECT_SIZE < count)
+    {
+        return false;
+    }
+
+    map.mapPath = path;
+    map.width = width;
+    map.height = height;
+    for (int d = 0; d < 4; ++d)
+    {
+        map.real[d] = data[16 + d];
+    }
+    map.numOfObstacle = 0;
+    map.obstacle.clear();
+    map.obstacleRects.resize(count);
+    const unsigned char *rectData = data + MAP_FILE_HEADER_SIZE;
+    for (uint32_t i = 0; i < count; ++i, rectData += MAP_FILE_RECT_SIZE)
+    {
+        uint32_t x = GetU32(rectData);
+        uint32_t y = GetU32(rectData + 4);
+        uint32_t rectWidth = GetU32(rectData + 8);
+        uint32_t rectHeight = GetU32(rectData + 12);
+        if (rectWidth < 1 || rectHeight < 1 || x >= width || y >= height || rectWidth > width - x || rectHeight > height - y)
+        {
+            return false;
+        }
+        map.obstacleRects[i] = {static_cast<int>(x), static_cast<int>(y), static_cast<int>(rectWidth), static_cast<int>(rectHeight)};
+    }
+    return true;
+}
+
+// 读取地图文件，二进制地图和文本地图都可以，文件不存在或格式错误时返回 false
+inline bool LoadMapFile(const string &path, Map &map)
+{
+    return IsBinaryMapFile(path) ? ReadBinaryMapFile(path, map) : ReadMapFile(path, map);
+}
+
+#endif
@@ -0,0 +1,307 @@
+/*Snake Game - Monte Carlo Tree Search
+2023.12
+蒙特卡洛树搜索玩家：从当前局面出发，在时间预算内反复模拟，选择平均收益最高的方向
+每个线程独立建一棵树并行搜索，最后合并根节点各方向的访问次数；模拟在位棋盘引擎的副本上进行，复制一个局面只是复制一块定长内存
+食物位置是随机的，树中的节点只记录走法序列，每次模拟重新从根局面按走法推演，食物由本次模拟的种子决定
+*/
+
+#ifndef SNAKE_MCTS_H
+#define SNAKE_MCTS_H
+
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "engine.h"
+#include "bitboard.h"
+#include "autopilot.h"
+#include "threadpool.h"
+
+using namespace std;
+
+// 蒙特卡洛树搜索玩家
+class MctsPlayer
+{
+private:
+    // 树节点，children 为四个方向的子节点下标，-1 表示还没有展开
+    struct Node
+    {
+        int children[4];
+        int visits;
+        double value;
+    };
+
+    // 一个线程的搜索结果
+    struct SearchResult
+    {
+        long long rollouts = 0;
+        int visits[4] = {};
+        double value[4] = {};
+    };
+
+    // 每次模拟最多推进的格数
+    static const int ROLLOUT_DEPTH = 30;
+    // 每走一格得分的折扣，越早吃到食物收益越高，否则各方向最终都能吃到食物，难以区分
+    static constexpr double DISCOUNT = 0.9;
+    // UCB 探索系数
+    static constexpr double EXPLORATION = 0.3;
+
+    // 线程数
+    int threads;
+    // 为每次搜索生成种子
+    Pcg32 random;
+    // 地图大小超出位棋盘引擎的范围时改用自动驾驶
+    Autopilot fallback;
+
+    // 上一次搜索的模拟次数和耗时
+    long long lastRollouts = 0;
+    double lastSeconds = 0;
+
+    // 一次模拟结束时局面的收益，范围为 [0, 1]，死亡的局面按存活格数给不超过 0.25 的收益
+    // 活着的局面不低于 0.5，吃到第一个食物的折扣得分越高越好，没吃到食物时离食物越近越好
+    // 只计第一个食物：之后的食物位置是随机的，它们带来的噪声会盖过各方向真正的差别
+    template <class Board>
+    static double Evaluate(const Board &state, double discountedGain, long long rootTicks)
+    {
+        if (state.IsGameOver() && !state.IsWon())
+        {
+            return 0.25 * (state.GetTicks() - rootTicks) / (ROLLOUT_DEPTH + 1);
+        }
+        if (discountedGain > 0)
+        {
+            return 0.55 + 0.45 * (discountedGain < 1 ? discountedGain : 1);
+        }
+        return 0.5 + 0.05 / (1 + state.FoodDistance(state.GetSnake(0)));
+    }
+
+    // 一个线程的搜索，直到 deadline
+    template <class Board>
+    static void SearchTree(const Board &root, uint64_t seed, chrono::steady_clock::time_point deadline, SearchResult &result)
+    {
+        vector<Node> tree;
+        tree.reserve(1 << 16);
+        tree.push_back({{-1, -1, -1, -1}, 0, 0});
+        Pcg32 rolloutRandom(seed, 3);
+        vector<int> path;
+        Board state;
+
+        // 每次检查时间之间的模拟次数，避免每次模拟都读时钟
+        const int CHECK_INTERVAL = 16;
+        while (result.rollouts % CHECK_INTERVAL != 0 || chrono::steady_clock::now() < deadline)
+        {
+            state = root;
+            state.Reseed(seed + result.rollouts + 1);
+            path.assign(1, 0);
+            int node = 0;
+            double discountedGain = 0;
+            double discount = 1;
+            // 走一步，记录吃到第一个食物时折扣后的得分
+            auto advance = [&](Direction direction)
+            {
+                int before = state.GetScore();
+                state.Step(direction);
+                if (discountedGain == 0)
+                {
+                    discountedGain = (state.GetScore() - before) * discount;
+                }
+                discount *= DISCOUNT;
+            };
+
+            // 选择：所有安全方向都展开过的节点按 UCB 选择子节点，直到遇到可以展开的节点、无路可走或游戏结束
+            while (!state.IsGameOver())
+            {
+                int unexpanded = -1;
+                int best = -1;
+                double bestScore = -1;
+                double logVisits = log(tree[node].visits + 1.0);
+                for (int d = 0; d < 4; ++d)
+                {
+                    // 立即撞死的方向不进树，模拟次数都留给有意义的走法
+                    if (!state.IsSafe(static_cast<Direction>(d)))
+                    {
+                        continue;
+                    }
+                    int child = tree[node].children[d];
+                    if (child == -1)
+                    {
+                        unexpanded = d;
+                        break;
+                    }
+                    double score = tree[child].value / tree[child].visits +
+                                   EXPLORATION * sqrt(logVisits / tree[child].visits);
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = d;
+                    }
+                }
+
+                if (unexpanded != -1)
+                {
+                    // 展开一个新节点
+                    int child = tree.size();
+                    tree[node].children[unexpanded] = child;
+                    tree.push_back({{-1, -1, -1, -1}, 0, 0});
+                    advance(static_cast<Direction>(unexpanded));
+                    path.push_back(child);
+                    break;
+                }
+                if (best == -1)
+                {
+                    // 四面都是死路，沿当前方向走一步结束游戏
+                    advance(state.GetDirection());
+                    break;
+                }
+                advance(static_cast<Direction>(best));
+                node = tree[node].children[best];
+                path.push_back(node);
+            }
+
+            // 模拟：只在不会立即撞死的方向中选择，有出口的格子优先于死胡同，大多数时候走向最近的食物，其余时候随机，直到游戏结束或达到模拟深度
+            long long endTicks = root.GetTicks() + ROLLOUT_DEPTH;
+            while (!state.IsGameOver() && state.GetTicks() < endTicks)
+            {
+                Direction moves[4];
+                int count = 0;
+                int greedy = -1;
+                int greedyDistance = 0;
+                bool open = false;
+                for (int d = 0; d < 4; ++d)
+                {
+                    if (state.IsSafe(static_cast<Direction>(d)))
+                    {
+                        int next = state.NextCell(static_cast<Direction>(d));
+                        bool exits = state.CountExits(next) > 0;
+                        if (exits && !open)
+                        {
+                            // 第一次遇到有出口的方向，之前的死胡同全部丢弃
+                            open = true;
+                            count = 0;
+                            greedy = -1;
+                        }
+                        else if (!exits && open)
+                        {
+                            continue;
+                        }
+                        int distance = state.FoodDistance(next);
+                        if (greedy == -1 || distance < greedyDistance)
+                        {
+                            greedy = count;
+                            greedyDistance = distance;
+                        }
+                        moves[count++] = static_cast<Direction>(d);
+                    }
+                }
+                if (count == 0)
+                {
+                    advance(state.GetDirection());
+                }
+                else if (rolloutRandom.NextBounded(4) != 0)
+                {
+                    advance(moves[greedy]);
+                }
+                else
+                {
+                    advance(moves[rolloutRandom.NextBounded(count)]);
+                }
+            }
+
+            // 回传
+            double value = Evaluate(state, discountedGain, root.GetTicks());
+            for (int index : path)
+            {
+                tree[index].visits++;
+                tree[index].value += value;
+            }
+            ++result.rollouts;
+        }
+
+        for (int d = 0; d < 4; ++d)
+        {
+            int child = tree[0].children[d];
+            if (child != -1)
+            {
+                result.visits[d] = tree[child].visits;
+                result.value[d] = tree[child].value;
+            }
+        }
+    }
+
+public:
+    // threadCount 不大于 0 时使用硬件线程数
+    explicit MctsPlayer(int threadCount = 0, uint64_t seed = 0) : threads(threadCount), random(seed, 4)
+    {
+        if (threads <= 0)
+        {
+            threads = thread::hardware_concurrency();
+        }
+        if (threads <= 0)
+        {
+            threads = 1;
+        }
+    }
+
+    int GetThreadCount() const { return threads; }
+    // 上一次搜索的模拟次数
+    long long GetRollouts() const { return lastRollouts; }
+    // 上一次搜索每秒的模拟次数
+    double GetRolloutsPerSecond() const { return lastSeconds > 0 ? lastRollouts / lastSeconds : 0; }
+
+    // 在 budgetMs 毫秒内搜索引擎当前局面，返回访问次数最多的方向
+    Direction Plan(const SnakeEngine &engine, long long budgetMs)
+    {
+        auto start = chrono::steady_clock::now();
+        auto deadline = start + chrono::milliseconds(budgetMs > 1 ? budgetMs : 1);
+        vector<SearchResult> results(threads);
+
+        const Map &map = engine.GetMap();
+        bool searched = WithBitboardEngine(map.width, map.height, [&](auto &root)
+                                           {
+                                               root.Load(engine, random.Next());
+                                               // 根节点并行：每个线程一棵树，互不通信
+                                               WorkStealingPool pool(threads);
+                                               for (int i = 0; i < threads; ++i)
+                                               {
+                                                   uint64_t seed = (static_cast<uint64_t>(random.Next()) << 32) | random.Next();
+                                                   SearchResult *result = &results[i];
+                                                   pool.Submit([&root, seed, deadline, result](int)
+                                                               { SearchTree(root, seed, deadline, *result); });
+                                               }
+                                               pool.Run(); });
+        lastSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        lastRollouts = 0;
+        if (!searched)
+        {
+            return fallback.Plan(engine);
+        }
+
+        // 合并各线程根节点的统计，选择访问次数最多的方向，访问次数相同时选平均收益高的
+        int visits[4] = {};
+        double value[4] = {};
+        for (const SearchResult &result : results)
+        {
+            lastRollouts += result.rollouts;
+            for (int d = 0; d < 4; ++d)
+            {
+                visits[d] += result.visits[d];
+                value[d] += result.value[d];
+            }
+        }
+        int best = -1;
+        for (int d = 0; d < 4; ++d)
+        {
+            if (visits[d] == 0)
+            {
+                continue;
+            }
+            if (best == -1 || visits[d] > visits[best] ||
+                (visits[d] == visits[best] && value[d] > value[best]))
+            {
+                best = d;
+            }
+        }
+        return best == -1 ? engine.GetDirection() : static_cast<Direction>(best);
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*Snake Game - Metrics
+2023.12
+每格各阶段耗时的统计：对数线性直方图按 2 的幂分组，每组再线性分成 16 个桶，相对误差不超过 1/16
+记录一次只需计算桶下标并加一，不分配内存；关闭时每个阶段只多一次判断，不读时钟
+游戏结束时输出摘要，并把摘要和各桶计数写入文本文件，便于比较不同版本
+*/
+
+#ifndef SNAKE_METRICS_H
+#define SNAKE_METRICS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// 统计的阶段
+enum MetricPhase
+{
+    // 处理队列中的按键，不含等待下一格的休眠
+    PHASE_INPUT,
+    // 自动驾驶或电脑玩家的规划
+    PHASE_PLAN,
+    // 推进一格，没有吃到食物
+    PHASE_MOVE,
+    // 推进一格并吃到食物，包括生成新的食物
+    PHASE_EAT,
+    // 绘制一帧
+    PHASE_DRAW,
+    // 相邻两格实际间隔的时间
+    PHASE_TICK,
+    // 实际间隔与目标间隔 1000 / gameDifficulty 毫秒之差的绝对值
+    PHASE_DRIFT,
+    // 读取到改变方向的按键到画出转向后的一帧
+    PHASE_LATENCY,
+    PHASE_COUNT
+};
+
+const char *const METRIC_PHASE_NAMES[PHASE_COUNT] = {"input", "plan", "move", "eat", "draw", "tick", "drift", "latency"};
+
+// 最高位的位置，value 不为 0
+inline int HighestBit64(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1)
+    {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+// 对数线性直方图，单位为纳秒
+// 小于 16 的值每个值一个桶，之后每个 [2^k, 2^(k+1)) 区间分成 16 个等宽的桶
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+private:
+    uint64_t counts[BUCKET_COUNT] = {};
+    uint64_t total = 0;
+    double sum = 0;
+    uint64_t minimum = 0;
+    uint64_t maximum = 0;
+
+public:
+    static int BucketIndex(uint64_t value)
+    {
+        if (value < SUB_COUNT)
+        {
+            return static_cast<int>(value);
+        }
+        int shift = HighestBit64(value) - SUB_BITS;
+        return (shift + 1) * SUB_COUNT + static_cast<int>((value >> shift) - SUB_COUNT);
+    }
+
+    // 第 index 个桶的下界，上界为下一个桶的下界
+    static uint64_t BucketLower(int index)
+    {
+        int group = index / SUB_COUNT;
+        uint64_t sub = index % SUB_COUNT;
+        return group == 0 ? sub : (SUB_COUNT + sub) << (group - 1);
+    }
+
+    // 记录一个值，负值记为 0
+    void Record(long long value)
+    {
+        uint64_t nanoseconds = value > 0 ? static_cast<uint64_t>(value) : 0;
+        counts[BucketIndex(nanoseconds)]++;
+        minimum = total == 0 ? nanoseconds : min(minimum, nanoseconds);
+        maximum = max(maximum, nanoseconds);
+        sum += nanoseconds;
+        ++total;
+    }
+
+    void Clear() { *this = LatencyHistogram(); }
+
+    uint64_t Count() const { return total; }
+    uint64_t Min() const { return minimum; }
+    uint64_t Max() const { return maximum; }
+    double Mean() const { return total == 0 ? 0 : sum / total; }
+    uint64_t BucketCount(int index) const { return counts[index]; }
+
+    // 第 percentile 百分位数，返回所在桶的上界，不超过最大值
+    uint64_t Percentile(double percentile) const
+    {
+        if (total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(percentile / 100 * total);
+        if (rank >= total)
+        {
+            rank = total - 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += counts[i];
+            if (seen > rank)
+            {
+                uint64_t upper = i + 1 < BUCKET_COUNT ? BucketLower(i + 1) - 1 : maximum;
+                return min(upper, maximum);
+            }
+        }
+        return maximum;
+    }
+};
+
+// 一局游戏的每格耗时统计，默认关闭
+class TickMetrics
+{
+private:
+    bool enabled = false;
+    LatencyHistogram histograms[PHASE_COUNT];
+    // 目标间隔，纳秒
+    long long targetNs = 0;
+    // 上一格推进的时间点，0 表示没有可比较的上一格
+    long long lastTickNs = 0;
+
+    // 纳秒转换为微秒的文字
+    static string Microseconds(double nanoseconds)
+    {
+        char text[32];
+        snprintf(text, sizeof(text), "%.1f", nanoseconds / 1000);
+        return text;
+    }
+
+public:
+    void Enable(bool value) { enabled = value; }
+    bool IsEnabled() const { return enabled; }
+
+    // 开始新的一局，清空统计
+    void Reset(long long newTargetNs)
+    {
+        for (LatencyHistogram &histogram : histograms)
+        {
+            histogram.Clear();
+        }
+        targetNs = newTargetNs;
+        lastTickNs = 0;
+    }
+
+    void Record(MetricPhase phase, long long nanoseconds)
+    {
+        if (enabled)
+        {
+            histograms[phase].Record(nanoseconds);
+        }
+    }
+
+    // 记录一格开始推进的时间点，与上一格比较得到实际间隔和偏差
+    void MarkTick(long long now)
+    {
+        if (!enabled)
+        {
+            return;
+        }
+        if (lastTickNs != 0)
+        {
+            long long interval = now - lastTickNs;
+            histograms[PHASE_TICK].Record(interval);
+            histograms[PHASE_DRIFT].Record(interval > targetNs ? interval - targetNs : targetNs - interval);
+        }
+        lastTickNs = now;
+    }
+
+    // 暂停等打断节奏的情况之后调用，下一格不与之前比较
+    void BreakTick() { lastTickNs = 0; }
+
+    const LatencyHistogram &GetHistogram(MetricPhase phase) const { return histograms[phase]; }
+
+    // 摘要，每个阶段一行，单位为微秒
+    vector<string> Summary() const
+    {
+        vector<string> lines;
+        lines.push_back("Tick target: " + Microseconds(targetNs) + " us");
+        char line[160];
+        snprintf(line, sizeof(line), "%-7s %8s %10s %10s %10s %10s %10s %10s", "phase", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+        lines.push_back(line);
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        {
+            const LatencyHistogram &histogram = histograms[phase];
+            snprintf(line, sizeof(line), "%-7s %8llu %10s %10s %10s %10s %10s %10s", METRIC_PHASE_NAMES[phase],
+                     static_cast<unsigned long long>(histogram.Count()), Microseconds(histogram.Mean()).c_str(),
+                     Microseconds(histogram.Percentile(50)).c_str(), Microseconds(histogram.Percentile(90)).c_str(),
+                     Microseconds(histogram.Percentile(99)).c_str(), Microseconds(histogram.Percentile(99.9)).c_str(),
+                     Microseconds(histogram.Max()).c_str());
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    // 写入摘要和每个阶段非空桶的计数，每行为 阶段 桶下界 桶上界 计数，单位为纳秒
+    bool WriteFile(const string &path) const
+    {
+        ofstream file(path);
+        if (!file)
+        {
+            return false;
+        }
+        for (const string &line : Summary())
+        {
+            file << line << "\n";
+        }
+        file << "\n";
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        {
+            const LatencyHistogram &histogram = histograms[phase];
+            for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i)
+            {
+                if (histogram.BucketCount(i) != 0)
+                {
+                    uint64_t upper = i + 1 < LatencyHistogram::BUCKET_COUNT ? LatencyHistogram::BucketLower(i + 1) - 1 : UINT64_MAX;
+                    file << METRIC_PHASE_NAMES[phase] << " " << LatencyHistogram::BucketLower(i) << " " << upper << " "
+                         << histogram.BucketCount(i) << "\n";
+                }
+            }
+        }
+        return static_cast<bool>(file);
+    }
+};
+
+#endif
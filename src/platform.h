@@ -0,0 +1,242 @@
+/*Snake Game - Platform
+2023.12
+平台相关的终端输入和计时：Windows 使用控制台 API，Linux 使用 termios 原始模式和 poll
+等待按键时进程休眠到按键到达或超时，不再忙等
+*/
+
+#ifndef SNAKE_PLATFORM_H
+#define SNAKE_PLATFORM_H
+
+#include <chrono>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <conio.h>
+#include <windows.h>
+#else
+#include <csignal>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#include "render.h"
+
+using namespace std;
+
+// 单调时钟，单位为毫秒，不受系统时间调整影响
+inline long long MonotonicMs()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 单调时钟，单位为纳秒，用于测量每格各阶段的耗时
+inline long long MonotonicNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef _WIN32
+// 进入原始模式前的终端设置
+inline termios &SavedTerminal()
+{
+    static termios saved;
+    return saved;
+}
+
+inline bool &RawModeActive()
+{
+    static bool active = false;
+    return active;
+}
+
+// 恢复终端设置，进程退出或被中断时也会调用
+inline void RestoreTerminal()
+{
+    if (RawModeActive())
+    {
+        tcsetattr(STDIN_FILENO, TCSANOW, &SavedTerminal());
+        RawModeActive() = false;
+    }
+}
+
+inline void RestoreTerminalOnSignal(int signal)
+{
+    RestoreTerminal();
+    std::signal(signal, SIG_DFL);
+    raise(signal);
+}
+#endif
+
+// 进入原始模式：按键不回显，不等待回车，立即交给程序
+inline void EnterRawMode()
+{
+#ifndef _WIN32
+    if (RawModeActive() || !isatty(STDIN_FILENO))
+    {
+        return;
+    }
+    static bool handlersInstalled = false;
+    if (!handlersInstalled)
+    {
+        atexit(RestoreTerminal);
+        std::signal(SIGINT, RestoreTerminalOnSignal);
+        std::signal(SIGTERM, RestoreTerminalOnSignal);
+        handlersInstalled = true;
+    }
+    tcgetattr(STDIN_FILENO, &SavedTerminal());
+    termios raw = SavedTerminal();
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    // 切换模式时不丢弃已输入的按键，菜单中提前输入的按键留给下一次读取；需要丢弃时调用 FlushInput
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+    RawModeActive() = true;
+#endif
+}
+
+// 离开原始模式，恢复行输入，供 cin 使用
+inline void LeaveRawMode()
+{
+#ifndef _WIN32
+    RestoreTerminal();
+#endif
+}
+
+// 在作用域内保持原始模式
+class RawModeGuard
+{
+private:
+    bool entered;
+
+public:
+    RawModeGuard()
+    {
+#ifdef _WIN32
+        entered = false;
+#else
+        entered = !RawModeActive();
+#endif
+        EnterRawMode();
+    }
+    ~RawModeGuard()
+    {
+        if (entered)
+        {
+            LeaveRawMode();
+        }
+    }
+};
+
+// 等待按键，最多等待 timeoutMs 毫秒，-1 表示一直等待；返回按键，超时返回 0
+inline int WaitKey(long long timeoutMs)
+{
+#ifdef _WIN32
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    long long deadline = MonotonicMs() + timeoutMs;
+    while (true)
+    {
+        if (_kbhit())
+        {
+            return _getch();
+        }
+        long long remaining = timeoutMs < 0 ? INFINITE : deadline - MonotonicMs();
+        if (remaining <= 0 || WaitForSingleObject(input, static_cast<DWORD>(remaining)) != WAIT_OBJECT_0)
+        {
+            return 0;
+        }
+        // 鼠标、焦点和按键抬起等事件也会唤醒，丢弃这些事件以免反复唤醒
+        INPUT_RECORD record;
+        DWORD count = 0;
+        if (!_kbhit() && PeekConsoleInput(input, &record, 1, &count) && count == 1 &&
+            !(record.EventType == KEY_EVENT && record.Event.KeyEvent.bKeyDown))
+        {
+            ReadConsoleInput(input, &record, 1, &count);
+        }
+    }
+#else
+    RawModeGuard guard;
+    pollfd descriptor = {STDIN_FILENO, POLLIN, 0};
+    long long deadline = MonotonicMs() + timeoutMs;
+    while (true)
+    {
+        long long remaining = timeoutMs < 0 ? -1 : deadline - MonotonicMs();
+        if (timeoutMs >= 0 && remaining < 0)
+        {
+            remaining = 0;
+        }
+        int ready = poll(&descriptor, 1, static_cast<int>(remaining));
+        if (ready > 0)
+        {
+            unsigned char key;
+            return read(STDIN_FILENO, &key, 1) == 1 ? key : 0;
+        }
+        // 被信号中断时继续等待剩余时间
+        if (ready == 0 || remaining == 0)
+        {
+            return 0;
+        }
+    }
+#endif
+}
+
+// 阻塞读取一个按键，按键不回显
+inline int GetKey()
+{
+    int key;
+    do
+    {
+        key = WaitKey(-1);
+    } while (key == 0);
+    return key;
+}
+
+// 丢弃所有尚未读取的按键
+inline void FlushInput()
+{
+#ifdef _WIN32
+    while (_kbhit())
+    {
+        _getch();
+    }
+#else
+    tcflush(STDIN_FILENO, TCIFLUSH);
+#endif
+}
+
+// 终端窗口可见区域的列数和行数，不是终端或无法获取时返回 false
+inline bool GetTerminalSize(int &columns, int &rows)
+{
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+    {
+        return false;
+    }
+    columns = info.srWindow.Right - info.srWindow.Left + 1;
+    rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+    return true;
+#else
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || size.ws_col == 0 || size.ws_row == 0)
+    {
+        return false;
+    }
+    columns = size.ws_col;
+    rows = size.ws_row;
+    return true;
+#endif
+}
+
+// 清屏并把光标移到左上角
+inline void ClearScreen()
+{
+    WriteOutput("\033[0m\033[H\033[2J");
+}
+
+#endif
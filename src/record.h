@@ -0,0 +1,787 @@
+/*Snake Game - Record
+2023.12
+事件记录：只保存地图、配置、随机种子和带格数的方向改变序列，回放时由引擎重新推演每一帧
+二进制画面记录：文件头、定期关键帧、关键帧之间的异或/游程增量帧和帧偏移索引，回放时内存映射逐帧解码
+*/
+
+#ifndef SNAKE_RECORD_H
+#define SNAKE_RECORD_H
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <iomanip>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "engine.h"
+
+using namespace std;
+
+// 事件记录文件的第一行，旧版逐帧记录的第一行是配置文件路径
+// 版本 2 在单格障碍物之后加上矩形障碍物，版本 1 的记录仍然可以读取
+const string EVENT_RECORD_MAGIC = "SNAKE-EVENTS";
+const int EVENT_RECORD_VERSION = 2;
+
+// 方向改变事件，在第 tick 格推进前把方向改为 direction
+struct InputEvent
+{
+    long long tick;
+    Direction direction;
+};
+
+// 一局游戏的事件记录
+struct GameRecord
+{
+    // 地图，包括全部障碍物，地图文件之后被修改也能回放
+    Map map;
+    // 配置
+    Config config;
+    // 引擎实际使用的随机种子
+    uint64_t seed = 0;
+    // 游戏共推进的格数
+    long long ticks = 0;
+    // 方向改变序列，按 tick 递增
+    vector<InputEvent> inputs;
+};
+
+// 写入事件记录
+inline bool WriteGameRecord(const string &path, const GameRecord &record)
+{
+    ofstream recordFile(path);
+    if (!recordFile)
+    {
+        return false;
+    }
+
+    const Config &config = record.config;
+    const Map &map = record.map;
+    recordFile << EVENT_RECORD_MAGIC << " " << EVENT_RECORD_VERSION << "\n";
+    recordFile << config.configPath << "\n";
+    recordFile << map.mapPath << "\n";
+    // 概率按最高精度保存，保证回放时食物分数的判断完全一致
+    recordFile << setprecision(17);
+    recordFile << config.gameDifficulty << " " << config.randomSeed << " " << config.numOfFood << " "
+               << config.foodProb[0] << " " << config.foodProb[1] << " " << config.foodProb[2] << "\n";
+    recordFile << map.width << " " << map.height << "\n";
+    recordFile << map.real[UP] << " " << map.real[DOWN] << " " << map.real[LEFT] << " " << map.real[RIGHT] << "\n";
+    recordFile << map.numOfObstacle << "\n";
+    for (int i = 0; i < map.numOfObstacle; ++i)
+    {
+        recordFile << map.obstacle[i].x << " " << map.obstacle[i].y << "\n";
+    }
+    recordFile << map.obstacleRects.size() << "\n";
+    for (const ObstacleRect &rect : map.obstacleRects)
+    {
+        recordFile << rect.x << " " << rect.y << " " << rect.width << " " << rect.height << "\n";
+    }
+    recordFile << record.seed << "\n";
+    recordFile << record.ticks << " " << record.inputs.size() << "\n";
+    for (const InputEvent &event : record.inputs)
+    {
+        recordFile << event.tick << " " << DirectionToKey(event.direction) << "\n";
+    }
+    return static_cast<bool>(recordFile);
+}
+
+// 读取事件记录
+inline bool ReadGameRecord(istream &recordFile, GameRecord &record)
+{
+    string magic;
+    int version;
+    recordFile >> magic >> version;
+    if (magic != EVENT_RECORD_MAGIC || version < 1 || version > EVENT_RECORD_VERSION)
+    {
+        return false;
+    }
+
+    Config &config = record.config;
+    Map &map = record.map;
+    recordFile >> config.configPath;
+    recordFile >> map.mapPath;
+    recordFile >> config.gameDifficulty >> config.randomSeed >> config.numOfFood;
+    recordFile >> config.foodProb[0] >> config.foodProb[1] >> config.foodProb[2];
+    recordFile >> map.width >> map.height;
+    recordFile >> map.real[UP] >> map.real[DOWN] >> map.real[LEFT] >> map.real[RIGHT];
+    recordFile >> map.numOfObstacle;
+    // 与地图文件和新建配置相同的限制，损坏或伪造的记录不能让引擎越界或除以零
+    if (!recordFile || map.width < MIN_MAP_SIZE || map.height < MIN_MAP_SIZE || map.width > MAX_MAP_SIZE || map.height > MAX_MAP_SIZE ||
+        map.numOfObstacle < 0 || config.gameDifficulty < MIN_DIFFICULTY || config.gameDifficulty > MAX_DIFFICULTY ||
+        config.numOfFood < MIN_NUM_OF_FOOD || config.numOfFood > MAX_NUM_OF_FOOD)
+    {
+        return false;
+    }
+    map.obstacle.clear();
+    for (int i = 0; i < map.numOfObstacle; ++i)
+    {
+        int x, y;
+        if (!(recordFile >> x >> y) || x < 0 || x >= map.width || y < 0 || y >= map.height)
+        {
+            return false;
+        }
+        map.obstacle.push_back({x, y});
+    }
+    map.obstacleRects.clear();
+    size_t numOfRects = 0;
+    if (version >= 2)
+    {
+        recordFile >> numOfRects;
+    }
+    for (size_t i = 0; i < numOfRects; ++i)
+    {
+        ObstacleRect rect;
+        if (!(recordFile >> rect.x >> rect.y >> rect.width >> rect.height) || rect.width < 1 || rect.height < 1 ||
+            rect.x < 0 || rect.y < 0 || rect.x >= map.width || rect.y >= map.height ||
+            rect.width > map.width - rect.x || rect.height > map.height - rect.y)
+        {
+            return false;
+        }
+        map.obstacleRects.push_back(rect);
+    }
+    recordFile >> record.seed;
+
+    size_t numOfInputs;
+    recordFile >> record.ticks >> numOfInputs;
+    if (!recordFile || record.ticks < 0)
+    {
+        return false;
+    }
+    // 方向改变发生在推进之前，格数按顺序递增且小于总格数
+    record.inputs.clear();
+    long long lastTick = 0;
+    for (size_t i = 0; i < numOfInputs; ++i)
+    {
+        InputEvent event;
+        char key;
+        if (!(recordFile >> event.tick >> key) || event.tick < lastTick || event.tick >= record.ticks ||
+            !KeyToDirection(key, event.direction))
+        {
+            return false;
+        }
+        lastTick = event.tick;
+        record.inputs.push_back(event);
+    }
+    return static_cast<bool>(recordFile);
+}
+
+// 二进制画面记录
+// 文件头：魔数 SNKR、版本、画面宽高（含边界）、难度、关键帧间隔、帧数、随机种子、索引偏移、配置和地图路径
+// 每一帧：类型（0 关键帧，1 增量帧）、分数、数据长度、数据
+//   关键帧数据为完整画面，增量帧数据为与上一帧异或后的游程编码：若干组（跳过的格数，变化的格数，变化的异或值）
+// 文件末尾为帧索引：每帧的文件偏移和分数
+const char FRAME_RECORD_MAGIC[4] = {'S', 'N', 'K', 'R'};
+const uint32_t FRAME_RECORD_VERSION = 1;
+const uint32_t FRAME_RECORD_KEYFRAME_INTERVAL = 64;
+const size_t FRAME_RECORD_HEADER_SIZE = 48;
+const size_t FRAME_RECORD_INDEX_ENTRY_SIZE = 12;
+
+enum FrameType : uint8_t
+{
+    KEY_FRAME = 0,
+    DELTA_FRAME = 1
+};
+
+// 二进制记录的元数据
+struct FrameRecordInfo
+{
+    uint32_t columns = 0;
+    uint32_t rows = 0;
+    uint32_t gameDifficulty = 1;
+    uint32_t keyframeInterval = FRAME_RECORD_KEYFRAME_INTERVAL;
+    uint64_t frameCount = 0;
+    uint64_t seed = 0;
+    string configPath;
+    string mapPath;
+};
+
+// 小端序写入和读取定长整数，保证不同平台生成的文件一致
+inline void PutU32(string &buffer, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        buffer.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+inline void PutU64(string &buffer, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        buffer.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+inline void PutVarint(string &buffer, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+inline uint32_t GetU32(const unsigned char *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline uint64_t GetU64(const unsigned char *data)
+{
+    return GetU32(data) | (static_cast<uint64_t>(GetU32(data + 4)) << 32);
+}
+
+// 读取变长整数，越界返回 false
+inline bool GetVarint(const unsigned char *&data, const unsigned char *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && data < end; shift += 7)
+    {
+        unsigned char byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 二进制记录写入器，逐帧追加，只保留上一帧和帧索引
+class FrameRecordWriter
+{
+private:
+    ofstream file;
+    FrameRecordInfo info;
+    // 上一帧画面，用于计算增量
+    Grid<char> previous;
+    // 当前帧画面
+    Grid<char> current;
+    // 帧索引
+    string index;
+    // 当前写入位置
+    uint64_t offset = 0;
+    // 数据缓冲
+    string buffer;
+
+    // 写入文件头，帧数和索引偏移在 Close 时回填
+    void WriteHeader(uint64_t indexOffset)
+    {
+        string header(FRAME_RECORD_MAGIC, 4);
+        PutU32(header, FRAME_RECORD_VERSION);
+        PutU32(header, info.columns);
+        PutU32(header, info.rows);
+        PutU32(header, info.gameDifficulty);
+        PutU32(header, info.keyframeInterval);
+        PutU64(header, info.frameCount);
+        PutU64(header, info.seed);
+        PutU64(header, indexOffset);
+        PutU32(header, info.configPath.size());
+        header += info.configPath;
+        PutU32(header, info.mapPath.size());
+        header += info.mapPath;
+        file.write(header.data(), header.size());
+        offset = header.size();
+    }
+
+public:
+    bool Open(const string &path, const FrameRecordInfo &recordInfo)
+    {
+        info = recordInfo;
+        info.frameCount = 0;
+        file.open(path, ios::binary | ios::trunc);
+        if (!file)
+        {
+            return false;
+        }
+        previous.Assign(info.columns, info.rows, 0);
+        current.Assign(info.columns, info.rows, 0);
+        index.clear();
+        WriteHeader(0);
+        return static_cast<bool>(file);
+    }
+
+    // 追加一帧，每 keyframeInterval 帧写一个关键帧，其余写增量帧
+    void AddFrame(const Grid<char> &screen, int score)
+    {
+        memcpy(current.Data(), screen.Data(), current.Size());
+
+        buffer.clear();
+        bool keyframe = info.frameCount % info.keyframeInterval == 0;
+        if (keyframe)
+        {
+            buffer.append(current.Data(), current.Size());
+        }
+        else
+        {
+            // 跳过相同的格子，连续变化的格子写入异或值
+            size_t size = current.Size();
+            size_t i = 0;
+            while (i < size)
+            {
+                size_t start = i;
+                while (i < size && current[i] == previous[i])
+                {
+                    ++i;
+                }
+                if (i == size)
+                {
+                    break;
+                }
+                size_t runStart = i;
+                while (i < size && current[i] != previous[i])
+                {
+                    ++i;
+                }
+                PutVarint(buffer, runStart - start);
+                PutVarint(buffer, i - runStart);
+                for (size_t j = runStart; j < i; ++j)
+                {
+                    buffer.push_back(current[j] ^ previous[j]);
+                }
+            }
+        }
+
+        PutU64(index, offset);
+        PutU32(index, static_cast<uint32_t>(score));
+
+        string frameHeader;
+        frameHeader.push_back(keyframe ? KEY_FRAME : DELTA_FRAME);
+        PutU32(frameHeader, static_cast<uint32_t>(score));
+        PutU32(frameHeader, buffer.size());
+        file.write(frameHeader.data(), frameHeader.size());
+        file.write(buffer.data(), buffer.size());
+        offset += frameHeader.size() + buffer.size();
+
+        previous.Swap(current);
+        ++info.frameCount;
+    }
+
+    // 写入帧索引并回填文件头
+    bool Close()
+    {
+        uint64_t indexOffset = offset;
+        file.write(index.data(), index.size());
+        file.seekp(0);
+        WriteHeader(indexOffset);
+        file.close();
+        return !file.fail();
+    }
+};
+
+// 只读内存映射文件
+class MappedFile
+{
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const string &path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            Close();
+            return false;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+        {
+            Close();
+            return false;
+        }
+        data = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            Close();
+            return false;
+        }
+        size = static_cast<size_t>(fileStat.st_size);
+        void *address = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = address == MAP_FAILED ? nullptr : static_cast<const unsigned char *>(address);
+        if (data != nullptr)
+        {
+            // 回放基本按顺序读取
+            madvise(address, size, MADV_SEQUENTIAL);
+        }
+#endif
+        if (data == nullptr)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+        {
+            UnmapViewOfFile(data);
+        }
+        if (mapping != NULL)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr)
+        {
+            munmap(const_cast<unsigned char *>(data), size);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+};
+
+// 判断文件是否为二进制画面记录
+inline bool IsFrameRecord(const string &path)
+{
+    ifstream file(path, ios::binary);
+    char magic[4] = {};
+    file.read(magic, 4);
+    return file && memcmp(magic, FRAME_RECORD_MAGIC, 4) == 0;
+}
+
+// 二进制记录读取器，内存映射文件，只保留当前一帧画面
+class FrameRecordReader
+{
+private:
+    MappedFile file;
+    FrameRecordInfo info;
+    // 帧索引在文件中的位置
+    const unsigned char *index = nullptr;
+    // 当前帧画面
+    Grid<char> frame;
+    // 当前帧序号，-1 表示还未解码
+    long long current = -1;
+
+    // 在当前画面上解码第 i 帧
+    bool DecodeFrame(long long i)
+    {
+        uint64_t offset = GetFrameOffset(i);
+        const unsigned char *end = file.Data() + file.Size();
+        if (offset + 9 > file.Size())
+        {
+            return false;
+        }
+        const unsigned char *data = file.Data() + offset;
+        uint8_t type = data[0];
+        uint32_t length = GetU32(data + 5);
+        data += 9;
+        if (length > static_cast<size_t>(end - data))
+        {
+            return false;
+        }
+        end = data + length;
+
+        if (type != KEY_FRAME && type != DELTA_FRAME)
+        {
+            return false;
+        }
+        if (type == KEY_FRAME)
+        {
+            if (length != static_cast<uint32_t>(frame.Size()))
+            {
+                return false;
+            }
+            memcpy(frame.Data(), data, length);
+            return true;
+        }
+
+        size_t position = 0;
+        while (data < end)
+        {
+            uint32_t skip, run;
+            if (!GetVarint(data, end, skip) || !GetVarint(data, end, run))
+            {
+                return false;
+            }
+            position += skip;
+            if (position + run > static_cast<size_t>(frame.Size()) || run > static_cast<size_t>(end - data))
+            {
+                return false;
+            }
+            for (uint32_t j = 0; j < run; ++j)
+            {
+                frame[position++] ^= *data++;
+            }
+        }
+        return true;
+    }
+
+    uint64_t GetFrameOffset(long long i) const { return GetU64(index + i * FRAME_RECORD_INDEX_ENTRY_SIZE); }
+
+public:
+    bool Open(const string &path)
+    {
+        current = -1;
+        if (!file.Open(path) || file.Size() < FRAME_RECORD_HEADER_SIZE)
+        {
+            return false;
+        }
+        const unsigned char *data = file.Data();
+        if (memcmp(data, FRAME_RECORD_MAGIC, 4) != 0 || GetU32(data + 4) != FRAME_RECORD_VERSION)
+        {
+            return false;
+        }
+        info.columns = GetU32(data + 8);
+        info.rows = GetU32(data + 12);
+        info.gameDifficulty = GetU32(data + 16);
+        info.keyframeInterval = GetU32(data + 20);
+        info.frameCount = GetU64(data + 24);
+        info.seed = GetU64(data + 32);
+        uint64_t indexOffset = GetU64(data + 40);
+        // 画面含边框，大小不超过最大地图加边框，避免损坏的文件头申请大量内存；难度用作回放时的除数
+        if (info.columns < 1 || info.rows < 1 || info.columns > MAX_MAP_SIZE + 2 || info.rows > MAX_MAP_SIZE + 2 ||
+            info.gameDifficulty == 0)
+        {
+            return false;
+        }
+
+        // 读取配置和地图路径
+        size_t position = FRAME_RECORD_HEADER_SIZE;
+        for (string *path : {&info.configPath, &info.mapPath})
+        {
+            if (position + 4 > file.Size())
+            {
+                return false;
+            }
+            uint32_t length = GetU32(data + position);
+            position += 4;
+            if (length > file.Size() - position)
+            {
+                return false;
+            }
+            path->assign(reinterpret_cast<const char *>(data + position), length);
+            position += length;
+        }
+
+        // 检查帧索引是否完整，未正常关闭的文件没有索引
+        if (indexOffset < position || info.keyframeInterval == 0 ||
+            indexOffset > file.Size() ||
+            (file.Size() - indexOffset) / FRAME_RECORD_INDEX_ENTRY_SIZE < info.frameCount)
+        {
+            return false;
+        }
+        index = data + indexOffset;
+        frame.Assign(info.columns, info.rows, 0);
+        return true;
+    }
+
+    const FrameRecordInfo &GetInfo() const { return info; }
+    long long GetFrameCount() const { return info.frameCount; }
+    // 第 i 帧的分数，直接从索引读取
+    int GetScore(long long i) const { return static_cast<int>(GetU32(index + i * FRAME_RECORD_INDEX_ENTRY_SIZE + 8)); }
+    const Grid<char> &GetFrame() const { return frame; }
+
+    // 定位到第 i 帧，顺序播放时只解码一个增量帧，跳转时从最近的关键帧开始解码
+    bool Seek(long long i)
+    {
+        if (i < 0 || i >= static_cast<long long>(info.frameCount))
+        {
+            return false;
+        }
+        if (i == current)
+        {
+            return true;
+        }
+        long long start = current + 1;
+        if (current < 0 || i < current || i - current > info.keyframeInterval)
+        {
+            start = i - i % info.keyframeInterval;
+        }
+        for (long long j = start; j <= i; ++j)
+        {
+            if (!DecodeFrame(j))
+            {
+                current = -1;
+                return false;
+            }
+        }
+        current = i;
+        return true;
+    }
+};
+
+// 回放事件记录时引擎快照占用内存的上限，局越长快照间隔越大
+const size_t REPLAY_SNAPSHOT_BYTES = 64 << 20;
+// 快照的最小间隔，格
+const long long REPLAY_SNAPSHOT_MIN_INTERVAL = 64;
+
+// 事件记录的回放索引：先推演一遍得到每一帧的分数，并每隔 interval 格保存一次引擎快照
+// 定位到任意一帧时，顺序播放只推进一格，其他情况从不晚于目标的最近快照开始推演，最多推演一个快照间隔
+class EventReplayIndex
+{
+private:
+    const GameRecord *record = nullptr;
+    vector<SnakeEngine> snapshots;
+    long long interval = REPLAY_SNAPSHOT_MIN_INTERVAL;
+    // 第 i 帧的分数，第 i 帧为推进 i 格之后的画面
+    vector<int> scores;
+    // 一局开始时的方向
+    Direction initialDirection = RIGHT;
+    // 调用方的引擎当前所在的帧，-1 表示未知
+    long long current = -1;
+
+    // 推进第 tick 格时使用的方向，即不晚于 tick 的最后一次方向改变，没有时为初始方向
+    Direction DirectionAt(long long tick) const
+    {
+        auto next = upper_bound(record->inputs.begin(), record->inputs.end(), tick, [](long long value, const InputEvent &event)
+                                { return value < event.tick; });
+        return next == record->inputs.begin() ? initialDirection : prev(next)->direction;
+    }
+
+public:
+    // 推演整局，record 在索引使用期间必须保持有效
+    void Build(const GameRecord &newRecord)
+    {
+        record = &newRecord;
+        snapshots.clear();
+        scores.clear();
+        current = -1;
+
+        SnakeEngine engine;
+        engine.ResetWithSeed(record->map, record->config, record->seed);
+        initialDirection = engine.GetDirection();
+        size_t snapshotBytes = sizeof(SnakeEngine) + engine.GetBoardBytes() + record->map.obstacle.size() * sizeof(Point) +
+                               record->map.obstacleRects.size() * sizeof(ObstacleRect);
+        long long budgetCount = max<long long>(1, REPLAY_SNAPSHOT_BYTES / snapshotBytes);
+        interval = max(REPLAY_SNAPSHOT_MIN_INTERVAL, (record->ticks + 1 + budgetCount - 1) / budgetCount);
+
+        for (long long tick = 0;; ++tick)
+        {
+            if (tick % interval == 0)
+            {
+                snapshots.push_back(engine);
+            }
+            scores.push_back(engine.GetScore());
+            if (tick == record->ticks || engine.IsGameOver())
+            {
+                break;
+            }
+            engine.Step(DirectionAt(tick));
+        }
+    }
+
+    long long GetFrameCount() const { return scores.size(); }
+    const vector<int> &GetScores() const { return scores; }
+    long long GetSnapshotInterval() const { return interval; }
+
+    // 把 engine 定位到第 frame 帧，两次调用之间调用方不能修改 engine
+    bool Seek(long long frame, SnakeEngine &engine)
+    {
+        if (frame < 0 || frame >= GetFrameCount())
+        {
+            return false;
+        }
+        if (current < 0 || frame < current || frame - current > interval)
+        {
+            engine = snapshots[frame / interval];
+            current = frame / interval * interval;
+        }
+        for (; current < frame; ++current)
+        {
+            engine.Step(DirectionAt(current));
+        }
+        return true;
+    }
+};
+
+// 用引擎重新推演事件记录，把每一帧写成二进制画面记录，内存占用与局长无关
+inline bool WriteFrameRecord(const string &path, const GameRecord &record)
+{
+    FrameRecordInfo info;
+    info.columns = record.map.width + 2;
+    info.rows = record.map.height + 2;
+    info.gameDifficulty = record.config.gameDifficulty;
+    info.seed = record.seed;
+    info.configPath = record.config.configPath;
+    info.mapPath = record.map.mapPath;
+
+    FrameRecordWriter writer;
+    if (!writer.Open(path, info))
+    {
+        return false;
+    }
+
+    SnakeEngine engine;
+    engine.ResetWithSeed(record.map, record.config, record.seed);
+    Direction direction = engine.GetDirection();
+    size_t nextInput = 0;
+    Grid<char> frame;
+    for (long long tick = 0;; ++tick)
+    {
+        engine.CopyScreen(frame);
+        writer.AddFrame(frame, engine.GetScore());
+        if (tick == record.ticks || engine.IsGameOver())
+        {
+            break;
+        }
+        while (nextInput < record.inputs.size() && record.inputs[nextInput].tick == tick)
+        {
+            direction = record.inputs[nextInput++].direction;
+        }
+        engine.Step(direction);
+    }
+    return writer.Close();
+}
+
+#endif
@@ -0,0 +1,344 @@
+/*Snake Game - Render
+2023.12
+双缓冲终端渲染：比较前后两帧，只输出变化的格子，用光标定位跳过未变化的部分，同色格子合并输出，整帧一次写出
+*/
+
+#ifndef SNAKE_RENDER_H
+#define SNAKE_RENDER_H
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// 格子颜色，对应 ANSI 背景色代码，0 为默认颜色
+enum CellColor : unsigned char
+{
+    COLOR_DEFAULT = 0,
+    COLOR_RED = 41,
+    COLOR_GREEN = 42,
+    COLOR_YELLOW = 43,
+    COLOR_BLUE = 44,
+    COLOR_PURPLE = 45
+};
+
+// 终端上的一个字符格
+struct Cell
+{
+    char ch = ' ';
+    unsigned char color = COLOR_DEFAULT;
+
+    bool operator==(const Cell &other) const { return ch == other.ch && color == other.color; }
+    bool operator!=(const Cell &other) const { return !(*this == other); }
+};
+
+// 把游戏画面中的字符转换为终端上的字符和颜色
+// 0 为空格，1 为 1 分食物，2 为 2 分食物，3 为 3 分食物，# 为蛇头，* 为蛇身，O 为障碍物
+inline Cell ScreenCell(char value, bool gameOver)
+{
+    switch (value)
+    {
+    case 'O':
+    case '|':
+    case '-':
+        return {value, COLOR_DEFAULT};
+    case '1':
+        // 1 分食物为蓝色
+        return {'@', COLOR_BLUE};
+    case '2':
+        // 2 分食物为紫色
+        return {'@', COLOR_PURPLE};
+    case '3':
+        // 3 分食物为黄色
+        return {'@', COLOR_YELLOW};
+    case '#':
+    case '*':
+        // 游戏结束时蛇为红色
+        return {value, gameOver ? COLOR_RED : COLOR_GREEN};
+    }
+    return {' ', COLOR_DEFAULT};
+}
+
+// 视口在一个方向上的起点：目标离开视口中间一半的区域时移动视口，让目标回到区域边缘，再限制在画面范围内
+// 蛇头在中间区域内移动时视口不动，终端只需重绘变化的格子
+inline int FollowView(int start, int target, int view, int total)
+{
+    int margin = view / 4;
+    if (target < start + margin)
+    {
+        start = target - margin;
+    }
+    else if (target > start + view - 1 - margin)
+    {
+        start = target - (view - 1 - margin);
+    }
+    return max(0, min(start, total - view));
+}
+
+// 让 width x height 的视口跟随画面中的目标，画面共 columns x rows 格；视口位置为负时先以目标为中心
+inline void FollowTarget(int &viewX, int &viewY, int targetX, int targetY, int width, int height, int columns, int rows)
+{
+    if (viewX < 0 || viewY < 0)
+    {
+        viewX = targetX - width / 2;
+        viewY = targetY - height / 2;
+    }
+    viewX = FollowView(viewX, targetX, width, columns);
+    viewY = FollowView(viewY, targetY, height, rows);
+}
+
+// 视口放不下整个画面时显示在画面下方的视口位置
+inline string ViewportText(int viewX, int viewY, int width, int height, int columns, int rows)
+{
+    return "View: x " + to_string(viewX) + "-" + to_string(viewX + width - 1) +
+           ", y " + to_string(viewY) + "-" + to_string(viewY + height - 1) +
+           " of " + to_string(columns) + "x" + to_string(rows);
+}
+
+// 一帧终端画面
+class FrameBuffer
+{
+private:
+    int width = 0;
+    int height = 0;
+    vector<Cell> cells;
+
+public:
+    void Resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        cells.assign(width * height, Cell());
+    }
+
+    void Clear() { cells.assign(cells.size(), Cell()); }
+
+    void Set(int x, int y, Cell cell)
+    {
+        if (x >= 0 && x < width && y >= 0 && y < height)
+        {
+            cells[y * width + x] = cell;
+        }
+    }
+
+    // 在第 y 行写入一行文字，超出宽度的部分被截断
+    void SetText(int y, const string &text)
+    {
+        for (int x = 0; x < (int)text.size(); ++x)
+        {
+            Set(x, y, {text[x], COLOR_DEFAULT});
+        }
+    }
+
+    const Cell &At(int x, int y) const { return cells[y * width + x]; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+};
+
+// 差分终端渲染器，back 为正在绘制的下一帧，front 为终端上已显示的一帧
+class TerminalRenderer
+{
+private:
+    FrameBuffer front;
+    FrameBuffer back;
+    // 终端内容是否未知，例如被其他输出覆盖，为真时下一帧清屏后完整重绘
+    bool invalid = true;
+    // 本帧要输出的字节
+    string output;
+    // 输出过程中终端当前的颜色
+    unsigned char currentColor = COLOR_DEFAULT;
+
+    // 相隔不超过该格数的两段变化合并输出，比重新定位光标更短
+    static const int MERGE_GAP = 4;
+
+    void MoveCursor(int x, int y)
+    {
+        output += "\033[";
+        output += to_string(y + 1);
+        output += ';';
+        output += to_string(x + 1);
+        output += 'H';
+    }
+
+    void PutCell(const Cell &cell)
+    {
+        // 颜色相同的连续格子只输出一次颜色代码
+        if (cell.color != currentColor)
+        {
+            if (cell.color == COLOR_DEFAULT)
+            {
+                output += "\033[0m";
+            }
+            else
+            {
+                output += "\033[";
+                output += to_string(cell.color);
+                output += 'm';
+            }
+            currentColor = cell.color;
+        }
+        output += cell.ch;
+    }
+
+public:
+    // 开始绘制新的一帧，尺寸变化时下一帧完整重绘
+    FrameBuffer &Begin(int width, int height)
+    {
+        if (width != back.Width() || height != back.Height())
+        {
+            back.Resize(width, height);
+            invalid = true;
+        }
+        else
+        {
+            back.Clear();
+        }
+        return back;
+    }
+
+    // 终端被其他输出覆盖后调用，下一帧清屏后完整重绘
+    void Invalidate() { invalid = true; }
+
+    // 生成把终端从上一帧更新到当前帧所需的输出，结束后光标停在画面下方
+    const string &Render()
+    {
+        output.clear();
+        currentColor = COLOR_DEFAULT;
+        int width = back.Width();
+        int height = back.Height();
+
+        if (invalid)
+        {
+            output += "\033[0m\033[H\033[2J";
+            for (int y = 0; y < height; ++y)
+            {
+                MoveCursor(0, y);
+                for (int x = 0; x < width; ++x)
+                {
+                    PutCell(back.At(x, y));
+                }
+            }
+            invalid = false;
+        }
+        else
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                int x = 0;
+                while (x < width)
+                {
+                    if (back.At(x, y) == front.At(x, y))
+                    {
+                        ++x;
+                        continue;
+                    }
+
+                    // 找到一段变化，向后合并间隔很小的下一段变化
+                    int end = x + 1;
+                    int gap = 0;
+                    for (int i = x + 1; i < width && gap <= MERGE_GAP; ++i)
+                    {
+                        if (back.At(i, y) != front.At(i, y))
+                        {
+                            end = i + 1;
+                            gap = 0;
+                        }
+                        else
+                        {
+                            ++gap;
+                        }
+                    }
+
+                    MoveCursor(x, y);
+                    for (int i = x; i < end; ++i)
+                    {
+                        PutCell(back.At(i, y));
+                    }
+                    x = end;
+                }
+            }
+        }
+
+        if (currentColor != COLOR_DEFAULT)
+        {
+            output += "\033[0m";
+        }
+        MoveCursor(0, height);
+
+        front = back;
+        return output;
+    }
+};
+
+// 绘制一帧游戏画面：视口内的格子按 ScreenCell 转换颜色，下方为 lines 中的文字，返回需要输出的内容
+// at(x, y) 为画面中 (x, y) 处的字符；画面宽度取视口、最长一行文字和 minWidth 中的最大值，宽度不变时只输出变化的格子
+template <class ScreenAt>
+inline const string &RenderScreen(TerminalRenderer &renderer, ScreenAt at, bool gameOver, int viewX, int viewY,
+                                  int viewWidth, int viewHeight, const vector<string> &lines, int minWidth = 0)
+{
+    int width = max(viewWidth, minWidth);
+    for (const string &line : lines)
+    {
+        width = max(width, (int)line.size());
+    }
+    FrameBuffer &frame = renderer.Begin(width, viewHeight + lines.size());
+    for (int i = 0; i < viewHeight; ++i)
+    {
+        for (int j = 0; j < viewWidth; ++j)
+        {
+            frame.Set(j, i, ScreenCell(at(viewX + j, viewY + i), gameOver));
+        }
+    }
+    for (int i = 0; i < (int)lines.size(); ++i)
+    {
+        frame.SetText(i + viewHeight, lines[i]);
+    }
+    return renderer.Render();
+}
+
+// 把数据一次写到标准输出，先清空 cout 缓冲区，保证输出顺序
+inline void WriteOutput(const string &data)
+{
+    cout.flush();
+#ifdef _WIN32
+    DWORD written;
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data.data(), static_cast<DWORD>(data.size()), &written, NULL);
+#else
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t written = write(STDOUT_FILENO, data.data() + offset, data.size() - offset);
+        if (written <= 0)
+        {
+            break;
+        }
+        offset += written;
+    }
+#endif
+}
+
+// 让 Windows 控制台解析 ANSI 转义序列，其他平台的终端默认支持
+inline void EnableVirtualTerminal()
+{
+#ifdef _WIN32
+    HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(output, &mode))
+    {
+        SetConsoleMode(output, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+}
+
+#endif
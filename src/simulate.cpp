@@ -0,0 +1,583 @@
+/*Snake Game - Headless Simulator
+2023.12
+无界面批量模拟：运行一组 (地图, 配置, 种子范围, 输入策略) 任务，分给工作窃取线程池在所有核心上并行执行
+统计分数和存活格数的均值与百分位数，以及各种结束原因的局数
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <cerrno>
+#include <cstdlib>
+
+#include "engine.h"
+#include "autopilot.h"
+#include "mcts.h"
+#include "bitboard.h"
+#include "threadpool.h"
+#include "mapfile.h"
+
+using namespace std;
+
+// 每个线程任务包含的局数，太小时调度开销占比变大，太大时各线程负载不均
+const int GAMES_PER_TASK = 16;
+
+// 模拟参数
+struct SimulateOptions
+{
+    // 地图文件路径
+    string mapPath = "map/default.map";
+    // 配置文件路径
+    string configPath = "config/default.config";
+    // 模拟局数
+    int games = 100;
+    // 每局最多推进的格数，防止脚本输入在虚边界地图上永不结束
+    long long maxTicks = 100000;
+    // 随机种子，-1 表示使用配置文件中的种子
+    int seed = -1;
+    // 输入策略，random 为随机转向，script 为循环执行脚本，auto 为自动驾驶，mcts 为蒙特卡洛树搜索
+    string policy = "random";
+    // mcts 策略每格的搜索时间，毫秒
+    long long budget = 10;
+    // 脚本，由 w/a/s/d 组成，每个字符对应一格
+    string script = "d";
+    // 任务列表文件，不为空时忽略上面的单个任务参数
+    string jobsPath;
+    // 线程数，0 表示使用硬件线程数
+    int threads = 0;
+    // 统计结果输出的 CSV 文件，为空时不输出
+    string outputPath;
+    // 引擎，grid 为 SnakeEngine，bitboard 为按地图大小特化的位棋盘引擎
+    string engine = "grid";
+};
+
+// 每个线程独占的引擎，按缓存行对齐，避免相邻线程的引擎状态落在同一缓存行上互相干扰
+struct alignas(64) WorkerEngine
+{
+    SnakeEngine engine;
+    Autopilot autopilot;
+    // 线程池已经占满所有线程，每个线程内的搜索只用一个线程
+    MctsPlayer computer{1};
+};
+
+// 一局游戏的结果
+struct GameResult
+{
+    int score;
+    long long ticks;
+    // 结束原因，达到格数上限仍未结束时为 END_NONE
+    EndReason reason;
+};
+
+// 一个模拟任务：在同一张地图和配置上，用一段种子各运行一局
+struct SimulateJob
+{
+    string mapPath;
+    string configPath;
+    Map map;
+    Config config;
+    // 种子范围 [seedBegin, seedEnd)，每个种子运行一局
+    long long seedBegin = 0;
+    long long seedEnd = 0;
+    // 为真时忽略种子范围内的种子，每局都使用配置文件中的种子，只用种子范围决定局数
+    bool configSeed = false;
+    string policy;
+    vector<Direction> script;
+    // mcts 策略每格的搜索时间，毫秒
+    long long budget = 10;
+    // 是否使用位棋盘引擎
+    bool bitboard = false;
+    // 每局的结果，按种子顺序存放，各线程写入不同的位置，不需要加锁
+    vector<GameResult> results;
+};
+
+void PrintUsage()
+{
+    cout << "Usage: simulate [options]" << endl;
+    cout << "  -m <map>        map file (default map/default.map)" << endl;
+    cout << "  -c <config>     config file (default config/default.config)" << endl;
+    cout << "  -n <games>      number of games (default 100)" << endl;
+    cout << "  -t <ticks>      max ticks per game (default 100000)" << endl;
+    cout << "  -s <seed>       base random seed, game i uses seed + i" << endl;
+    cout << "  -p <policy>     random | script | auto | mcts (default random)" << endl;
+    cout << "  -i <script>     w/a/s/d moves for script policy, or @file to read from a file" << endl;
+    cout << "  -j <jobs>       jobs file, one job per line: map config seedBegin seedEnd policy" << endl;
+    cout << "                  policy is random, auto, mcts, script:<moves> or script:@<file>; seedEnd is excluded" << endl;
+    cout << "  -b <ms>         search time per tick for the mcts policy (default 10)" << endl;
+    cout << "  -T <threads>    worker threads (default: all hardware threads)" << endl;
+    cout << "  -o <file>       write per-job statistics as CSV" << endl;
+    cout << "  -e <engine>     grid | bitboard (default grid); bitboard needs an 8-20 x 8-20 map" << endl;
+    cout << "                  and plays different games than grid for the same seed" << endl;
+}
+
+// 把整个字符串解析为 T 范围内的十进制整数，有多余字符、为空或超出范围时返回 false
+template <class T>
+bool ParseInteger(const string &text, T &value)
+{
+    char *end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno == ERANGE ||
+        parsed < numeric_limits<T>::min() || parsed > numeric_limits<T>::max())
+    {
+        return false;
+    }
+    value = static_cast<T>(parsed);
+    return true;
+}
+
+bool ParseOptions(int argc, char *argv[], SimulateOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "-h" || arg == "--help" || i + 1 >= argc)
+        {
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "-m")
+        {
+            options.mapPath = value;
+        }
+        else if (arg == "-c")
+        {
+            options.configPath = value;
+        }
+        else if (arg == "-n")
+        {
+            if (!ParseInteger(value, options.games))
+            {
+                return false;
+            }
+        }
+        else if (arg == "-t")
+        {
+            if (!ParseInteger(value, options.maxTicks))
+            {
+                return false;
+            }
+        }
+        else if (arg == "-s")
+        {
+            if (!ParseInteger(value, options.seed))
+            {
+                return false;
+            }
+        }
+        else if (arg == "-p")
+        {
+            options.policy = value;
+        }
+        else if (arg == "-b")
+        {
+            if (!ParseInteger(value, options.budget))
+            {
+                return false;
+            }
+        }
+        else if (arg == "-i")
+        {
+            options.script = value;
+        }
+        else if (arg == "-j")
+        {
+            options.jobsPath = value;
+        }
+        else if (arg == "-T")
+        {
+            if (!ParseInteger(value, options.threads))
+            {
+                return false;
+            }
+        }
+        else if (arg == "-o")
+        {
+            options.outputPath = value;
+        }
+        else if (arg == "-e")
+        {
+            options.engine = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return (options.policy == "random" || options.policy == "script" || options.policy == "auto" || options.policy == "mcts") &&
+           (options.engine == "grid" || options.engine == "bitboard");
+}
+
+// 读取脚本，@ 开头表示从文件读取
+bool LoadScript(const string &text, vector<Direction> &script)
+{
+    string scriptText = text;
+    if (!scriptText.empty() && scriptText[0] == '@')
+    {
+        ifstream scriptFile(scriptText.substr(1));
+        if (!scriptFile)
+        {
+            cout << "Failed to load script file " << scriptText.substr(1) << endl;
+            return false;
+        }
+        scriptText.assign(istreambuf_iterator<char>(scriptFile), istreambuf_iterator<char>());
+    }
+    script.clear();
+    for (char key : scriptText)
+    {
+        Direction direction;
+        if (KeyToDirection(key, direction))
+        {
+            script.push_back(direction);
+        }
+    }
+    if (script.empty())
+    {
+        cout << "Script is empty." << endl;
+        return false;
+    }
+    return true;
+}
+
+// 读取任务的地图和配置，为结果分配空间
+bool PrepareJob(SimulateJob &job)
+{
+    if (!LoadMapFile(job.mapPath, job.map))
+    {
+        cout << "Failed to load map file " << job.mapPath << endl;
+        return false;
+    }
+    if (!ReadConfigFile(job.configPath, job.config))
+    {
+        cout << "Failed to load configuration file " << job.configPath << endl;
+        return false;
+    }
+    if (job.seedEnd < job.seedBegin)
+    {
+        cout << "Invalid seed range " << job.seedBegin << " " << job.seedEnd << endl;
+        return false;
+    }
+    job.results.resize(job.seedEnd - job.seedBegin);
+    return true;
+}
+
+// 读取任务列表文件，空行和 # 开头的行被忽略
+bool LoadJobs(const string &path, vector<SimulateJob> &jobs)
+{
+    ifstream jobsFile(path);
+    if (!jobsFile)
+    {
+        cout << "Failed to load jobs file " << path << endl;
+        return false;
+    }
+    string line;
+    int lineNumber = 0;
+    while (getline(jobsFile, line))
+    {
+        ++lineNumber;
+        istringstream stream(line);
+        SimulateJob job;
+        if (!(stream >> job.mapPath) || job.mapPath[0] == '#')
+        {
+            continue;
+        }
+        if (!(stream >> job.configPath >> job.seedBegin >> job.seedEnd >> job.policy))
+        {
+            cout << "Invalid job at line " << lineNumber << ": " << line << endl;
+            return false;
+        }
+        if (job.policy.compare(0, 7, "script:") == 0)
+        {
+            if (!LoadScript(job.policy.substr(7), job.script))
+            {
+                return false;
+            }
+            job.policy = "script";
+        }
+        else if (job.policy != "random" && job.policy != "auto" && job.policy != "mcts")
+        {
+            cout << "Unknown policy at line " << lineNumber << ": " << job.policy << endl;
+            return false;
+        }
+        if (job.seedBegin < 0)
+        {
+            cout << "Invalid seed range at line " << lineNumber << endl;
+            return false;
+        }
+        if (!PrepareJob(job))
+        {
+            return false;
+        }
+        jobs.push_back(move(job));
+    }
+    return true;
+}
+
+// 运行一局游戏，seed 为 -1 时使用配置文件中的种子，Engine 为 SnakeEngine 或 BitboardEngine
+template <class Engine>
+GameResult PlayGame(Engine &engine, Autopilot &autopilot, MctsPlayer &computer, const SimulateJob &job, long long seed, long long maxTicks)
+{
+    if (seed == -1)
+    {
+        engine.Reset(job.map, job.config);
+    }
+    else
+    {
+        engine.ResetWithSeed(job.map, job.config, seed);
+    }
+
+    // 随机输入使用与食物不同的序列，避免与食物位置相关
+    Pcg32 inputRandom(engine.GetSeed(), 1);
+    Direction direction = engine.GetDirection();
+    while (!engine.IsGameOver() && engine.GetTicks() < maxTicks)
+    {
+        if (job.policy == "script")
+        {
+            direction = job.script[engine.GetTicks() % job.script.size()];
+        }
+        else if (job.policy == "auto" || job.policy == "mcts")
+        {
+            // 自动驾驶和树搜索读取 SnakeEngine 的状态，这两种任务不会使用位棋盘引擎
+            if constexpr (is_same<Engine, SnakeEngine>::value)
+            {
+                direction = job.policy == "auto" ? autopilot.Plan(engine) : computer.Plan(engine, job.budget);
+            }
+        }
+        else if (inputRandom.NextBounded(10) == 0)
+        {
+            // 随机策略：每格有 1/10 的概率转向
+            direction = static_cast<Direction>(inputRandom.NextBounded(4));
+        }
+        engine.Step(direction);
+    }
+    return {engine.GetScore(), engine.GetTicks(), engine.GetEndReason()};
+}
+
+// 一组结果的统计
+struct Statistics
+{
+    long long games = 0;
+    long long totalTicks = 0;
+    double meanScore = 0;
+    int scoreP50 = 0;
+    int scoreP90 = 0;
+    int scoreP99 = 0;
+    int bestScore = 0;
+    double meanTicks = 0;
+    long long ticksP50 = 0;
+    long long ticksP90 = 0;
+    long long ticksP99 = 0;
+    // 各结束原因的局数，下标为 EndReason，END_NONE 表示达到格数上限
+    long long reasons[END_STOPPED + 1] = {};
+};
+
+// 排好序的数据中的第 p 百分位数，使用最近秩法
+template <typename T>
+T Percentile(const vector<T> &sorted, int p)
+{
+    if (sorted.empty())
+    {
+        return T();
+    }
+    size_t rank = (sorted.size() * p + 99) / 100;
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+Statistics Summarize(const vector<const GameResult *> &results)
+{
+    Statistics stats;
+    stats.games = results.size();
+    vector<int> scores;
+    vector<long long> ticks;
+    scores.reserve(results.size());
+    ticks.reserve(results.size());
+    long long totalScore = 0;
+    for (const GameResult *result : results)
+    {
+        scores.push_back(result->score);
+        ticks.push_back(result->ticks);
+        totalScore += result->score;
+        stats.totalTicks += result->ticks;
+        ++stats.reasons[result->reason];
+    }
+    sort(scores.begin(), scores.end());
+    sort(ticks.begin(), ticks.end());
+    if (stats.games > 0)
+    {
+        stats.meanScore = static_cast<double>(totalScore) / stats.games;
+        stats.meanTicks = static_cast<double>(stats.totalTicks) / stats.games;
+        stats.bestScore = scores.back();
+    }
+    stats.scoreP50 = Percentile(scores, 50);
+    stats.scoreP90 = Percentile(scores, 90);
+    stats.scoreP99 = Percentile(scores, 99);
+    stats.ticksP50 = Percentile(ticks, 50);
+    stats.ticksP90 = Percentile(ticks, 90);
+    stats.ticksP99 = Percentile(ticks, 99);
+    return stats;
+}
+
+void PrintStatistics(const string &title, const Statistics &stats)
+{
+    cout << title << endl;
+    cout << "  Games: " << stats.games << endl;
+    cout << "  Ticks: " << stats.totalTicks << endl;
+    cout << fixed << setprecision(2);
+    cout << "  Score: mean " << stats.meanScore << ", p50 " << stats.scoreP50 << ", p90 " << stats.scoreP90
+         << ", p99 " << stats.scoreP99 << ", best " << stats.bestScore << endl;
+    cout << "  Survival ticks: mean " << stats.meanTicks << ", p50 " << stats.ticksP50 << ", p90 " << stats.ticksP90
+         << ", p99 " << stats.ticksP99 << endl;
+    cout << "  End: wall " << stats.reasons[END_WALL] << ", obstacle " << stats.reasons[END_OBSTACLE]
+         << ", self " << stats.reasons[END_SELF] << ", win " << stats.reasons[END_WIN]
+         << ", timeout " << stats.reasons[END_NONE] << endl;
+}
+
+void WriteStatisticsRow(ofstream &output, const string &map, const string &config, const string &seeds,
+                        const string &policy, const Statistics &stats)
+{
+    output << map << ',' << config << ',' << seeds << ',' << policy << ',' << stats.games << ','
+           << stats.meanScore << ',' << stats.scoreP50 << ',' << stats.scoreP90 << ',' << stats.scoreP99 << ','
+           << stats.bestScore << ',' << stats.meanTicks << ',' << stats.ticksP50 << ',' << stats.ticksP90 << ','
+           << stats.ticksP99 << ',' << stats.reasons[END_WALL] << ',' << stats.reasons[END_OBSTACLE] << ','
+           << stats.reasons[END_SELF] << ',' << stats.reasons[END_WIN] << ',' << stats.reasons[END_NONE] << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    SimulateOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    vector<SimulateJob> jobs;
+    if (!options.jobsPath.empty())
+    {
+        if (!LoadJobs(options.jobsPath, jobs))
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        // 没有任务列表时，命令行参数组成一个任务
+        SimulateJob job;
+        job.mapPath = options.mapPath;
+        job.configPath = options.configPath;
+        job.policy = options.policy;
+        if (options.policy == "script" && !LoadScript(options.script, job.script))
+        {
+            return 1;
+        }
+        job.seedBegin = options.seed == -1 ? 0 : options.seed;
+        job.seedEnd = job.seedBegin + options.games;
+        job.configSeed = options.seed == -1;
+        if (!PrepareJob(job))
+        {
+            return 1;
+        }
+        jobs.push_back(move(job));
+    }
+
+    // 位棋盘引擎只支持 8-20 x 8-20 的地图，自动驾驶和树搜索只能驱动 SnakeEngine，其他任务仍使用 SnakeEngine
+    for (SimulateJob &job : jobs)
+    {
+        job.budget = options.budget;
+        if (options.engine == "bitboard")
+        {
+            job.bitboard = FitsBitboard(job.map) && job.policy != "auto" && job.policy != "mcts";
+            if (!job.bitboard)
+            {
+                cout << "Note: " << job.mapPath << " with policy " << job.policy << " runs on the grid engine." << endl;
+            }
+        }
+    }
+
+    // 每个线程持有自己的引擎、自动驾驶和树搜索玩家，线程之间没有共享状态
+    WorkStealingPool pool(options.threads);
+    vector<WorkerEngine> engines(pool.GetThreadCount());
+    for (SimulateJob &job : jobs)
+    {
+        long long games = job.results.size();
+        for (long long first = 0; first < games; first += GAMES_PER_TASK)
+        {
+            long long last = min(games, first + GAMES_PER_TASK);
+            SimulateJob *target = &job;
+            long long maxTicks = options.maxTicks;
+            pool.Submit([target, first, last, maxTicks, &engines](int worker)
+                        {
+                            // 位棋盘引擎放在栈上，按地图大小选择特化版本，整块任务共用一个
+                            auto playAll = [&](auto &engine)
+                            {
+                                for (long long i = first; i < last; ++i)
+                                {
+                                    long long seed = target->configSeed ? -1 : target->seedBegin + i;
+                                    target->results[i] = PlayGame(engine, engines[worker].autopilot, engines[worker].computer, *target, seed, maxTicks);
+                                }
+                            };
+                            if (!target->bitboard || !WithBitboardEngine(target->map.width, target->map.height, playAll))
+                            {
+                                playAll(engines[worker].engine);
+                            } });
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    pool.Run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ofstream output;
+    if (!options.outputPath.empty())
+    {
+        output.open(options.outputPath);
+        if (!output)
+        {
+            cout << "Failed to open output file " << options.outputPath << endl;
+            return 1;
+        }
+        output << fixed << setprecision(2);
+        output << "map,config,seeds,policy,games,mean_score,p50_score,p90_score,p99_score,best_score,"
+               << "mean_ticks,p50_ticks,p90_ticks,p99_ticks,wall,obstacle,self,win,timeout" << endl;
+    }
+
+    vector<const GameResult *> all;
+    for (const SimulateJob &job : jobs)
+    {
+        vector<const GameResult *> results;
+        for (const GameResult &result : job.results)
+        {
+            results.push_back(&result);
+            all.push_back(&result);
+        }
+        Statistics stats = Summarize(results);
+        string seeds = job.configSeed ? "config" : to_string(job.seedBegin) + "-" + to_string(job.seedEnd);
+        if (jobs.size() > 1)
+        {
+            PrintStatistics(job.mapPath + " " + job.configPath + " " + seeds + " " + job.policy, stats);
+        }
+        if (output.is_open())
+        {
+            WriteStatisticsRow(output, job.mapPath, job.configPath, seeds, job.policy, stats);
+        }
+    }
+
+    Statistics total = Summarize(all);
+    if (output.is_open() && jobs.size() > 1)
+    {
+        WriteStatisticsRow(output, "total", "", "", "", total);
+    }
+    PrintStatistics("Total", total);
+    cout << "Engine: " << options.engine << endl;
+    cout << "Threads: " << pool.GetThreadCount() << endl;
+    cout << "Elapsed: " << seconds << " s" << endl;
+    cout << "Ticks/s: " << (seconds > 0 ? total.totalTicks / seconds : 0.0) << endl;
+    return 0;
+}
@@ -8,121 +8,119 @@
 #include <sstream>
 #include <ctime>
 #include <cstdlib>
-#include <conio.h>
-#include <windows.h>
 #include <string>
 #include <memory>
 #include <filesystem>
 #include <vector>
 #include <algorithm>
 
-using namespace std;
-
-// 方向
-enum Direction
-{
-    UP,
-    DOWN,
-    LEFT,
-    RIGHT
-};
+#include "engine.h"
+#include "autopilot.h"
+#include "mcts.h"
+#include "record.h"
+#include "mapfile.h"
+#include "assetcache.h"
+#include "metrics.h"
+#include "input.h"
+#include "render.h"
+#include "leaderboard.h"
+#include "platform.h"
 
-// 坐标
-struct Point
-{
-    int x;
-    int y;
-};
-
-// 食物
-struct Food
-{
-    int x;
-    int y;
-    int value;
-};
+using namespace std;
 
-// 配置
-struct Config
+// 控制蛇的一方
+enum Controller
 {
-    // 难度，1-10，蛇移动速度为每 1 / gameDifficulty 秒移动一格
-    int gameDifficulty;
-    // 随机种子
-    int randomSeed = -1;
-    // 食物数量，1-5
-    int numOfFood;
-    // 食物概率，0-1，分别为 1、2、3 分食物的概率
-    double foodProb[3] = {0.1, 0.3, 0.6};
-    // 配置文件路径
-    string configPath;
+    // 玩家用方向键控制
+    HUMAN,
+    // A* 自动驾驶，用于演示和长时间测试
+    AUTOPILOT,
+    // 蒙特卡洛树搜索，每格用一格的时间搜索
+    COMPUTER
 };
 
-// 地图
-struct Map
-{
-    // 地图宽度
-    int width;
-    // 地图高度
-    int height;
-    // 地图边界属性，0 为虚边界，1 为实边界
-    int real[4];
-    // 障碍物数量
-    int numOfObstacle;
-    // 障碍物坐标
-    vector<Point> obstacle;
-    // 地图文件路径
-    string mapPath;
-};
+// 无法获取终端大小时假定的终端列数和行数
+const int DEFAULT_TERMINAL_COLUMNS = 80;
+const int DEFAULT_TERMINAL_ROWS = 24;
 
-struct LeaderboardEntry
+// 读取 last.map、last.config 中记录的文件路径，文件不存在时返回 false
+inline bool ReadPathFile(const string &path, string &target)
 {
-    string name;
-    int score;
-    string date;
-    string time;
-    string configPath;
-    string mapPath;
-};
+    ifstream pathFile(path);
+    if (!pathFile)
+    {
+        return false;
+    }
+    target.clear();
+    getline(pathFile, target);
+    return true;
+}
 
 // 贪吃蛇游戏类
 class SnakeGame
 {
 private:
-    // 当前方向
+    // 游戏引擎，负责游戏规则
+    SnakeEngine engine;
+    // 玩家选择的方向
     Direction currentDirection;
-    // 蛇头即将移动到的位置
-    Point snakeHead;
-    // 蛇
-    vector<Point> snake;
-    // 食物
-    vector<Food> food;
     // 配置
     Config config;
     // 地图
     Map map;
+    // 解析后的地图、配置和上次使用的文件路径，文件的大小和修改时间不变时不再读取
+    AssetCache<Map> mapCache;
+    AssetCache<Config> configCache;
+    AssetCache<string> pathCache;
 
-    // 蛇长度，初始为 4，每吃一个食物加 1，已用 vector<Point> snake.size() 代替
-    int snakeLength;
     // 当前分数
     int score;
-    // 分数记录
-    vector<int> scoreRecord;
     // 游戏是否结束
     bool gameOver;
     // 游戏是否暂停
     bool gamePause;
     // 是否回放
     bool replay;
-
-    // 地图计数，用于回放
-    int screenCount = 0;
-    // 当前游戏画面
-    vector<vector<char>> screen;
-    // 游戏画面记录，用于回放
-    vector<vector<vector<char>>> screenRecord;
+    // 控制蛇的一方
+    Controller controller;
+    // 自动驾驶
+    Autopilot autopilot;
+    // 蒙特卡洛树搜索玩家
+    MctsPlayer computer;
+    // 下一格的时间点，单调时钟毫秒，按固定步长推进以抵消误差累积
+    long long nextTick;
+
+    // 回放画面记录时的当前画面，游戏中和回放事件记录时直接读取引擎的画面
+    Grid<char> screen;
+    // 当前画面是否来自画面记录
+    bool recordScreen;
+    // 视口左上角在画面中的坐标，地图比终端大时只绘制视口内的格子，-1 表示下一帧以蛇头为中心
+    int viewX;
+    int viewY;
+    // 本局的事件记录，用于保存和回放
+    GameRecord record;
+    // 回放的进度、速度和状态，显示在画面下方
+    string replayStatus;
+    // 终端渲染器，每帧只输出变化的格子
+    TerminalRenderer renderer;
+    // 每格各阶段的耗时统计，用 --metrics 开启
+    TickMetrics metrics;
+    // 游戏中的按键读取线程和按键队列
+    InputReader input;
+    // 本格应用的方向键被读取到的时间点，画出下一帧后统计延迟，0 表示没有
+    long long appliedKeyNs;
+
+    // 开启统计时读取纳秒时钟，关闭时返回 0，不读时钟
+    long long MetricsNow() const { return metrics.IsEnabled() ? MonotonicNs() : 0; }
+    // 输出本局的统计摘要，并写入 metrics 文件夹
+    void SaveMetrics();
 
     // 拓展功能：排行榜
-    vector<LeaderboardEntry> leaderboard;
+    Leaderboard leaderboard;
+    // 排行榜是否已经打开，每个进程只打开一次，之后只读入新加的记录
+    bool leaderboardOpened = false;
+    // 第一次使用时打开排行榜，之后只读入其他进程新加的记录，失败时输出原因
+    bool OpenLeaderboard();
 
 public:
     // 构造函数
@@ -132,16 +130,20 @@ public:
 
     // 初始化
     void Init();
-    // 运行游戏
-    void Run();
+    // 开启每格耗时统计
+    void EnableMetrics() { metrics.Enable(true); }
+    // 运行游戏，由 gameController 控制蛇
+    void Run(Controller gameController = HUMAN);
     // 绘制地图
     void DrawMap();
-    // 生成食物，用于初始化，生成 config.numOfFood 个食物
-    void GenerateFood();
-    // 生成食物，用于吃掉一个食物后生成一个新的食物
-    void GenerateFood(int i);
     // 移动蛇
     void MoveSnake();
+    // 从引擎同步分数和游戏状态，画面在绘制时直接从引擎读取
+    void SyncEngine();
+    // 画面中 (x, y) 处的字符
+    char ScreenAt(int x, int y) const { return recordScreen ? screen.At(x, y) : engine.GetScreen(x, y); }
+    // 按视口大小让视口跟随蛇头
+    void UpdateViewport(int viewWidth, int viewHeight);
     // 处理输入
     void HandleInput();
     // 暂停游戏
@@ -153,6 +155,20 @@ public:
     void SaveRecord();
     // 回放
     void Replay();
+    // 回放二进制画面记录，内存映射后逐帧解码
+    void ReplayBinary(const string &recordPath);
+    // 回放事件记录，由引擎重新推演每一帧
+    void ReplayEvents(istream &recordFile);
+    // 回放旧版逐帧记录，全部读入内存后回放
+    void ReplayFrames(istream &recordFile, const string &configPath);
+    // 回放控制：播放、暂停、倍速、倒放、逐帧和跳转，按 q 返回
+    // scores 为每一帧的分数，seek(i) 把画面切换到第 i 帧，失败时返回 false
+    template <class Seek>
+    void ScrubReplay(const vector<int> &scores, Seek seek);
+    // 回放时在状态行输入一个非负整数，按回车确认，按 Esc 或 q 取消时返回 -1
+    long long ReadReplayNumber(const string &prompt);
+    // 把下一格的时间点推进 interval 毫秒，落后超过一个步长时不再追赶
+    void AdvanceTick(long long interval);
 
     // 创建配置文件
     void CreateConfig();
@@ -160,6 +176,8 @@ public:
     void LoadConfig();
     // 加载上次使用的配置文件
     void LoadLastConfig();
+    // 创建 config 文件夹和默认配置文件
+    void PrepareConfigDirectory();
 
     // 创建地图文件
     void CreateMap();
@@ -167,6 +185,8 @@ public:
     void LoadMap();
     // 加载上次使用的地图文件
     void LoadLastMap();
+    // 创建 map 文件夹和默认地图文件
+    void PrepareMapDirectory();
 
     // 拓展功能：排行榜
     // 更新排行榜
@@ -186,438 +206,233 @@ void SnakeGame::Init()
     LoadLastMap();
     LoadLastConfig();
 
-    // 初始化 screen、snake、food、score、gameOver、replay 变量
-    screen.clear();
-    screen.resize(map.height + 2, vector<char>(map.width + 2, '0'));
-    screenRecord.clear();
-    screenCount = 0;
-    snake.clear();
-    snake.resize(4);
-    food.clear();
-    food.resize(config.numOfFood);
-    score = 0;
-    scoreRecord.clear();
-    gameOver = false;
+    // 初始化 replay 变量，游戏状态由引擎初始化
     replay = false;
-
-    // 根据地图大小初始化蛇的坐标
-    snake[0].x = map.width / 2 + 1;
-    snake[0].y = map.height / 2 + 1;
-
-    for (int i = 0; i < map.height + 2; ++i)
-        for (int j = 0; j < map.width + 2; ++j)
-            screen[i][j] = '0';
-
-    screen[snake[0].y][snake[0].x] = '#';
-
-    for (int i = 1; i < 4; ++i)
-    {
-        snake[i].x = map.width / 2 - i + 1;
-        snake[i].y = map.height / 2 + 1;
-        screen[snake[i].y][snake[i].x] = '*';
-    }
-
-    // 设置障碍物
-    if (map.numOfObstacle > 0)
-    {
-        for (int i = 0; i < map.numOfObstacle; ++i)
-        {
-            screen[map.obstacle[i].y + 1][map.obstacle[i].x + 1] = 'O';
-        }
-    }
-
-    // 设置边界
-    if (map.real[LEFT] == 1)
-    {
-        for (int i = 0; i < map.height + 2; ++i)
-        {
-            screen[i][0] = '|';
-        }
-    }
-    if (map.real[RIGHT] == 1)
-    {
-        for (int i = 0; i < map.height + 2; ++i)
-        {
-            screen[i][map.width + 1] = '|';
-        }
-    }
-    if (map.real[UP] == 1)
-    {
-        for (int i = 0; i < map.width + 2; ++i)
-        {
-            screen[0][i] = '-';
-        }
-    }
-    if (map.real[DOWN] == 1)
-    {
-        for (int i = 0; i < map.width + 2; ++i)
-        {
-            screen[map.height + 1][i] = '-';
-        }
-    }
-
-    // 生成食物
-    GenerateFood();
+    controller = HUMAN;
+    gamePause = false;
+    recordScreen = false;
+    viewX = -1;
+    viewY = -1;
+    // 终端上是菜单，第一帧需要完整重绘
+    renderer.Invalidate();
+
+    engine.Reset(map, config);
+    SyncEngine();
+
+    // 事件记录只保存地图、配置和随机种子，之后只追加方向改变
+    record.map = map;
+    record.config = config;
+    record.seed = engine.GetSeed();
+    record.ticks = 0;
+    record.inputs.clear();
     // 设置初始方向为向右
     currentDirection = RIGHT;
 }
 
-void SnakeGame::Run()
+void SnakeGame::SyncEngine()
+{
+    score = engine.GetScore();
+    gameOver = engine.IsGameOver();
+}
+
+void SnakeGame::Run(Controller gameController)
 {
     Init();
+    // 自动驾驶的邻接表等与地图面积成正比，稀疏地图上只能由玩家控制
+    if (gameController != HUMAN && static_cast<long long>(map.width) * map.height > SPARSE_MAP_CELLS)
+    {
+        cout << "The autopilot and the computer player support maps of up to " << SPARSE_MAP_CELLS << " cells." << endl;
+        cout << "Enter any key to go back to main menu." << endl;
+        GetKey();
+        return;
+    }
+    controller = gameController;
+    // 游戏过程中终端处于原始模式，按键立即送达且不回显，由读取线程放入队列
+    EnterRawMode();
+    input.Start();
+    appliedKeyNs = 0;
+    nextTick = MonotonicMs();
+    metrics.Reset(1000000000LL / config.gameDifficulty);
+    Direction recordedDirection = currentDirection;
     while (!gameOver)
     {
-        // 保存当前游戏画面和分数，用于回放
-        screenRecord.push_back(screen);
-        ++screenCount;
-        scoreRecord.push_back(score);
+        long long drawStart = MetricsNow();
         DrawMap();
+        long long drawEnd = MetricsNow();
+        metrics.Record(PHASE_DRAW, drawEnd - drawStart);
+        if (appliedKeyNs != 0)
+        {
+            metrics.Record(PHASE_LATENCY, drawEnd - appliedKeyNs);
+            appliedKeyNs = 0;
+        }
         HandleInput();
+        // 记录方向改变，用于回放
+        if (currentDirection != recordedDirection)
+        {
+            record.inputs.push_back({engine.GetTicks(), currentDirection});
+            recordedDirection = currentDirection;
+        }
+        // 吃到食物时蛇变长，这一格还包括生成新的食物
+        int length = engine.GetLength();
+        long long moveStart = MetricsNow();
+        metrics.MarkTick(moveStart);
         MoveSnake();
+        metrics.Record(engine.GetLength() > length ? PHASE_EAT : PHASE_MOVE, MetricsNow() - moveStart);
     }
+    // 结束后需要输入记录文件名和玩家姓名，停止读取线程并恢复行输入
+    input.Stop();
+    LeaveRawMode();
+    record.ticks = engine.GetTicks();
     EndGame();
 }
 
 void SnakeGame::DrawMap()
 {
-    // 清屏
-    system("cls");
-
-    // 绘制画面，根据不同的字符，输出不同的字符和颜色
-    // 0 为空格，1 为 1 分食物，2 为 2 分食物，3 为 3 分食物，# 为蛇头，* 为蛇身，O 为障碍物
-    for (int i = 0; i <= map.height + 1; ++i)
-    {
-        for (int j = 0; j <= map.width + 1; ++j)
-        {
-            if (screen[i][j] == '0')
-            {
-                cout << ' ';
-            }
-            else if (screen[i][j] == 'O' || screen[i][j] == '|' || screen[i][j] == '-')
-            {
-                cout << screen[i][j];
-            }
-            else if (screen[i][j] == '1')
-            {
-                // 1 分食物为蓝色
-                cout << "\033[44m@\033[0m";
-            }
-            else if (screen[i][j] == '2')
-            {
-                // 2 分食物为紫色
-                cout << "\033[45m@\033[0m";
-            }
-            else if (screen[i][j] == '3')
-            {
-                // 3 分食物为黄色
-                cout << "\033[43m@\033[0m";
-            }
-            else if (screen[i][j] == '#')
-            {
-                if (gameOver)
-                {
-                    // 游戏结束时蛇头为红色
-                    cout << "\033[41m#\033[0m";
-                }
-                else
-                {
-                    cout << "\033[42m#\033[0m";
-                }
-            }
-            else if (screen[i][j] == '*')
-            {
-                if (gameOver)
-                {
-                    // 游戏结束时蛇身为红色
-                    cout << "\033[41m*\033[0m";
-                }
-                else
-                {
-                    cout << "\033[42m*\033[0m";
-                }
-            }
-        }
-        cout << endl;
-    }
+    // 画面下方的文字
+    vector<string> lines;
 
     // 输出分数
     if (!gameOver)
     {
-        cout << "Current score: " << score << endl;
+        lines.push_back("Current score: " + to_string(score));
+    }
+    else if (!replay && engine.IsWon())
+    {
+        lines.push_back("You filled the whole map! Your score is " + to_string(score));
     }
     else
     {
-        cout << "Game over! Your score is " << score << endl;
+        lines.push_back("Game over! Your score is " + to_string(score));
     }
 
     // 输出配置文件路径和地图文件路径
-    cout << "Config: " << config.configPath << endl;
-    cout << "Map: " << map.mapPath << endl;
+    lines.push_back("Config: " + config.configPath);
+    lines.push_back("Map: " + map.mapPath);
 
     // 根据游戏状态输出提示信息
     if (!replay)
     {
         if (!gameOver)
         {
-            if (!gamePause)
+            if (!gamePause && controller == AUTOPILOT)
+            {
+                lines.push_back("Autopilot is playing. Enter space to pause.");
+            }
+            else if (!gamePause && controller == COMPUTER)
+            {
+                lines.push_back("Computer is playing (" + to_string(computer.GetThreadCount()) + " threads, " +
+                                to_string((long long)computer.GetRolloutsPerSecond()) + " rollouts/s). Enter space to pause.");
+            }
+            else if (!gamePause)
             {
-                cout << "Enter space to pause, w/a/s/d to move." << endl;
+                lines.push_back("Enter space to pause, w/a/s/d to move.");
             }
             else
             {
-                cout << "Enter space to continue, q to quit." << endl;
+                lines.push_back("Enter space to continue, q to quit.");
             }
         }
         else
         {
-            cout << "Enter b to save record, l to update leaderboard, or any key to go back to main menu." << endl;
+            lines.push_back("Enter b to save record, l to update leaderboard, or any key to go back to main menu.");
         }
     }
     else
     {
-        if (!gameOver)
-        {
-            cout << "Enter q to quit." << endl;
-        }
-        else
-        {
-            cout << "Replay finished. Enter any key to go back to main menu." << endl;
-        }
+        lines.push_back(replayStatus);
+        lines.push_back("space pause, 1/2/8/0 speed, r reverse, ,/. step, g tick, s score, q quit");
     }
-}
 
-void SnakeGame::GenerateFood()
-{
-    // 根据随机种子初始化随机数生成器
-    srand(config.randomSeed == -1 ? time(NULL) : config.randomSeed);
-
-    // 生成食物
-    for (int i = 0; i < config.numOfFood; ++i)
+    // 视口大小：终端放得下时显示整个画面，否则只显示终端放得下的部分
+    // 下方留出文字、视口位置和光标各占的行
+    int columns = DEFAULT_TERMINAL_COLUMNS;
+    int rows = DEFAULT_TERMINAL_ROWS;
+    GetTerminalSize(columns, rows);
+    int viewWidth = min(map.width + 2, max(columns, 3));
+    int viewHeight = min(map.height + 2, max(rows - (int)lines.size() - 2, 3));
+    UpdateViewport(viewWidth, viewHeight);
+    if (viewWidth < map.width + 2 || viewHeight < map.height + 2)
     {
-        // 食物不能生成在蛇身上
-        do
-        {
-            food[i].x = rand() % map.width + 1;
-            food[i].y = rand() % map.height + 1;
-        } while (screen[food[i].y][food[i].x] != '0');
-
-        // 根据概率生成不同分数的食物
-        float randValue = static_cast<float>(rand()) / RAND_MAX;
-        if (randValue < config.foodProb[0])
-        {
-            food[i].value = 1;
-            screen[food[i].y][food[i].x] = '1';
-        }
-        else if (randValue < config.foodProb[0] + config.foodProb[1])
-        {
-            food[i].value = 2;
-            screen[food[i].y][food[i].x] = '2';
-        }
-        else
-        {
-            food[i].value = 3;
-            screen[food[i].y][food[i].x] = '3';
-        }
+        lines.push_back(ViewportText(viewX, viewY, viewWidth, viewHeight, map.width + 2, map.height + 2));
     }
+
+    // 在后台缓冲区中绘制视口内的画面，耗时只与视口大小有关；只输出与上一帧不同的部分，一次写出
+    WriteOutput(RenderScreen(renderer, [this](int x, int y)
+                             { return ScreenAt(x, y); },
+                             gameOver, viewX, viewY, viewWidth, viewHeight, lines));
 }
 
-void SnakeGame::GenerateFood(int i)
+void SnakeGame::UpdateViewport(int viewWidth, int viewHeight)
 {
-    // 根据随机种子初始化随机数生成器
-    srand(config.randomSeed == -1 ? time(NULL) : config.randomSeed);
-
-    // 食物不能生成在蛇身上
-    do
-    {
-        food[i].x = rand() % map.width + 1;
-        food[i].y = rand() % map.height + 1;
-    } while (screen[food[i].y][food[i].x] != '0');
-
-    // 根据概率生成不同分数的食物
-    float randValue = static_cast<float>(rand()) / RAND_MAX;
-    if (randValue < config.foodProb[0])
-    {
-        food[i].value = 1;
-        screen[food[i].y][food[i].x] = '1';
-    }
-    else if (randValue < config.foodProb[0] + config.foodProb[1])
+    // 画面记录中没有蛇头的位置，视口停在左上角
+    if (recordScreen)
     {
-        food[i].value = 2;
-        screen[food[i].y][food[i].x] = '2';
-    }
-    else
-    {
-        food[i].value = 3;
-        screen[food[i].y][food[i].x] = '3';
+        viewX = 0;
+        viewY = 0;
+        return;
     }
+    Point head = engine.GetSnake(0);
+    FollowTarget(viewX, viewY, head.x, head.y, viewWidth, viewHeight, map.width + 2, map.height + 2);
 }
 
 void SnakeGame::MoveSnake()
 {
-    // 蛇头即将移动到的位置
-    snakeHead.x = snake[0].x;
-    snakeHead.y = snake[0].y;
-
-    // 根据方向移动蛇头
-    switch (currentDirection)
-    {
-    case UP:
-        snakeHead.y--;
-        break;
-    case DOWN:
-        snakeHead.y++;
-        break;
-    case LEFT:
-        snakeHead.x--;
-        break;
-    case RIGHT:
-        snakeHead.x++;
-        break;
-    }
-
-    // 判断蛇头是否撞到边界，如果是则游戏结束
-    if (snakeHead.y == 0)
-    {
-        if (map.real[UP] == 1)
-        {
-            gameOver = true;
-            return;
-        }
-        else
-        {
-            snakeHead.y = map.height;
-        }
-    }
-    if (snakeHead.y == map.height + 1)
-    {
-        if (map.real[DOWN] == 1)
-        {
-            gameOver = true;
-            return;
-        }
-        else
-        {
-            snakeHead.y = 1;
-        }
-    }
-    if (snakeHead.x == 0)
-    {
-        if (map.real[LEFT] == 1)
-        {
-            gameOver = true;
-            return;
-        }
-        else
-        {
-            snakeHead.x = map.width;
-        }
-    }
-    if (snakeHead.x == map.width + 1)
-    {
-        if (map.real[RIGHT] == 1)
-        {
-            gameOver = true;
-            return;
-        }
-        else
-        {
-            snakeHead.x = 1;
-        }
-    }
-
-    // 判断蛇头是否撞到蛇身，如果是则游戏结束
-    for (int i = 1; i < snake.size() - 1; ++i)
-    {
-        if (snakeHead.x == snake[i].x && snakeHead.y == snake[i].y)
-        {
-            gameOver = true;
-            return;
-        }
-    }
+    // 由引擎推进一格，再同步画面和分数
+    engine.Step(currentDirection);
+    SyncEngine();
+}
 
-    // 判断蛇头是否撞到障碍物，如果是则游戏结束
-    if (map.numOfObstacle > 0)
-    {
-        for (int i = 0; i < map.numOfObstacle; ++i)
+void SnakeGame::HandleInput()
+{
+    // 休眠到下一格的时间点，期间的按键由读取线程带时间戳放入队列
+    AdvanceTick(1000 / config.gameDifficulty);
+    // 蒙特卡洛树搜索用这一格的时间搜索，留出绘制的余量
+    Direction planned = currentDirection;
+    if (controller == COMPUTER && !gameOver)
+    {
+        long long planStart = MetricsNow();
+        planned = computer.Plan(engine, nextTick - MonotonicMs() - 2);
+        metrics.Record(PHASE_PLAN, MetricsNow() - planStart);
+    }
+    this_thread::sleep_until(chrono::steady_clock::time_point(chrono::milliseconds(nextTick)));
+
+    // 按读取顺序处理队列中的按键，每格最多应用一次方向改变，之后的按键留到下一格
+    // 与当前方向相同或相反的方向键、太旧的按键直接丢弃；输入为空格则暂停游戏
+    long long inputStart = MetricsNow();
+    long long paused = 0;
+    long long maxAgeNs = INPUT_MAX_AGE_TICKS * 1000000LL * (1000 / config.gameDifficulty);
+    KeyEvent event;
+    while (input.Pop(event))
+    {
+        if (event.key == ' ')
         {
-            if (snakeHead.x == map.obstacle[i].x + 1 && snakeHead.y == map.obstacle[i].y + 1)
-            {
-                gameOver = true;
-                return;
-            }
+            long long pauseStart = MetricsNow();
+            PauseGame();
+            paused += MetricsNow() - pauseStart;
+            break;
         }
-    }
-
-    // 移动蛇
-    screen[snake[snake.size() - 1].y][snake[snake.size() - 1].x] = '0';
-
-    int tempX = snake[snake.size() - 1].x;
-    int tempY = snake[snake.size() - 1].y;
-
-    for (int i = snake.size() - 1; i > 0; --i)
-    {
-        snake[i].x = snake[i - 1].x;
-        snake[i].y = snake[i - 1].y;
-    }
-
-    snake[0].x = snakeHead.x;
-    snake[0].y = snakeHead.y;
-
-    screen[snake[0].y][snake[0].x] = '#';
-    screen[snake[1].y][snake[1].x] = '*';
-
-    // 判断蛇头是否吃到食物，如果是则加分并生成新的食物
-    for (int i = 0; i < config.numOfFood; ++i)
-    {
-        if (snake[0].x == food[i].x && snake[0].y == food[i].y)
+        Direction direction;
+        if (controller != HUMAN || !KeyToDirection(event.key, direction) || MonotonicNs() - event.timeNs > maxAgeNs ||
+            direction == engine.GetDirection() || IsOpposite(direction, engine.GetDirection()))
         {
-            score += food[i].value;
-            snakeLength++;
-            // 还原蛇尾
-            snake.push_back({tempX, tempY});
-            screen[tempY][tempX] = '*';
-            GenerateFood(i);
+            continue;
         }
+        currentDirection = direction;
+        appliedKeyNs = metrics.IsEnabled() ? event.timeNs : 0;
+        break;
     }
-}
-
-void SnakeGame::HandleInput()
-{
-    // 只处理1000 / gameDifficulty毫秒内的最后一个输入
-    DWORD endTime = GetTickCount64() + 1000 / config.gameDifficulty;
-    char key = 0;
+    metrics.Record(PHASE_INPUT, MetricsNow() - inputStart - paused);
 
-    while (GetTickCount64() < endTime)
+    // 自动驾驶或电脑玩家控制时方向键不起作用
+    if (controller == AUTOPILOT && !gameOver)
     {
-        if (_kbhit())
-        {
-            key = _getch();
-        }
+        long long planStart = MetricsNow();
+        currentDirection = autopilot.Plan(engine);
+        metrics.Record(PHASE_PLAN, MetricsNow() - planStart);
     }
-
-    // 处理输入，如果输入为q则退出游戏，如果输入为其他方向键则改变方向，如果输入为空格则暂停游戏
-    if (key != 0)
+    else if (controller == COMPUTER && !gameOver)
     {
-        if (key == 'w' && currentDirection != DOWN)
-        {
-            currentDirection = UP;
-        }
-        else if (key == 'a' && currentDirection != RIGHT)
-        {
-            currentDirection = LEFT;
-        }
-        else if (key == 's' && currentDirection != UP)
-        {
-            currentDirection = DOWN;
-        }
-        else if (key == 'd' && currentDirection != LEFT)
-        {
-            currentDirection = RIGHT;
-        }
-        else if (key == ' ')
-        {
-            PauseGame();
-        }
+        currentDirection = planned;
     }
 }
 
@@ -628,35 +443,33 @@ void SnakeGame::PauseGame()
     DrawMap();
     while (true)
     {
-        if (_kbhit())
+        // 从按键队列阻塞等待按键，暂停期间不占用 CPU
+        char key = input.WaitPop().key;
+        if (key == ' ')
         {
-            char key = _getch();
-            if (key == ' ')
-            {
-                break;
-            }
-            else if (key == 'q')
-            {
-                gameOver = true;
-                break;
-            }
+            break;
+        }
+        else if (key == 'q')
+        {
+            gameOver = true;
+            engine.Stop();
+            break;
         }
     }
     gamePause = false;
+    // 继续游戏后从当前时间重新计时，暂停的这一格不计入间隔统计
+    nextTick = MonotonicMs();
+    metrics.BreakTick();
 }
 
-#include <iostream>
-#include <conio.h>  // 对于 _getch() 和 _kbhit()
-
 void SnakeGame::EndGame()
 {
-    // 保存最后一帧游戏画面和分数，用于回放
-    screenRecord.push_back(screen);
-    ++screenCount;
-    scoreRecord.push_back(score);
-
     // 绘制最后一帧游戏画面
     DrawMap();
+    if (metrics.IsEnabled())
+    {
+        SaveMetrics();
+    }
 
     bool bPressed = false;
     bool lPressed = false;
@@ -665,10 +478,10 @@ void SnakeGame::EndGame()
     while (true)
     {
         // 用户输入
-        key = _getch();
+        key = GetKey();
 
         // 清空缓冲区
-        while (_kbhit()) _getch();
+        FlushInput();
 
         // 检查是否需要保存记录，并确保只执行一次
         if (key == 'b')
@@ -709,6 +522,33 @@ void SnakeGame::EndGame()
 
 
 
+void SnakeGame::SaveMetrics()
+{
+    for (const string &line : metrics.Summary())
+    {
+        cout << line << endl;
+    }
+
+    // 文件名为结束时间，每局一个文件
+    filesystem::path dir = "metrics";
+    if (!filesystem::exists(dir))
+    {
+        filesystem::create_directories(dir);
+    }
+    time_t now = time(0);
+    char name[32];
+    strftime(name, sizeof(name), "%Y%m%d-%H%M%S", localtime(&now));
+    string metricsPath = "metrics/" + string(name) + ".txt";
+    if (metrics.WriteFile(metricsPath))
+    {
+        cout << "Metrics saved to " << metricsPath << "." << endl;
+    }
+    else
+    {
+        cout << "Failed to save metrics." << endl;
+    }
+}
+
 void SnakeGame::SaveRecord()
 {
     filesystem::path dir = "record";
@@ -733,40 +573,21 @@ void SnakeGame::SaveRecord()
     {
         cout << "Record file already exists." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
-    ofstream newRecordFile(recordPath);
-    if (!newRecordFile)
+    // 按事件记录重新推演，保存为带关键帧和增量帧的二进制画面记录
+    // 稀疏地图的每一帧都与地图面积一样大，只保存事件记录，回放时由引擎重新推演
+    bool sparse = static_cast<long long>(record.map.width) * record.map.height > SPARSE_MAP_CELLS;
+    if (!(sparse ? WriteGameRecord(recordPath, record) : WriteFrameRecord(recordPath, record)))
     {
         cout << "Failed to create record file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
-    // 保存配置文件路径、地图文件路径、难度、地图大小、地图计数、游戏画面和分数
-    newRecordFile << config.configPath << endl;
-    newRecordFile << map.mapPath << endl;
-    newRecordFile << config.gameDifficulty << endl;
-    newRecordFile << map.height << " " << map.width << endl;
-    newRecordFile << screenCount << endl;
-
-    for (int i = 0; i < screenCount; ++i)
-    {
-        for (int j = 0; j <= map.height + 1; ++j)
-        {
-            for (int k = 0; k <= map.width + 1; ++k)
-            {
-                newRecordFile << screenRecord[i][j][k];
-            }
-            newRecordFile << endl;
-        }
-        newRecordFile << scoreRecord[i] << endl;
-    }
-    newRecordFile.close();
-
     cout << "Record saved." << endl;
 }
 
@@ -788,70 +609,291 @@ void SnakeGame::Replay()
     {
         cout << "Record file does not exist." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
-    // 读取配置文件路径、地图文件路径、难度、地图大小、地图计数、游戏画面和分数
-    recordFile >> config.configPath;
+    // 终端上是菜单，第一帧需要完整重绘
+    renderer.Invalidate();
+    RawModeGuard rawMode;
+
+    // 二进制画面记录以 FRAME_RECORD_MAGIC 开头
+    if (IsFrameRecord(recordPath))
+    {
+        recordFile.close();
+        ReplayBinary(recordPath);
+        replay = false;
+        gameOver = false;
+        return;
+    }
+
+    // 根据第一行判断文本记录格式，事件记录以 EVENT_RECORD_MAGIC 开头
+    string firstLine;
+    getline(recordFile, firstLine);
+    if (firstLine.compare(0, EVENT_RECORD_MAGIC.size(), EVENT_RECORD_MAGIC) == 0)
+    {
+        recordFile.seekg(0);
+        ReplayEvents(recordFile);
+    }
+    else
+    {
+        ReplayFrames(recordFile, firstLine);
+    }
+
+    replay = false;
+    gameOver = false;
+}
+
+void SnakeGame::ReplayBinary(const string &recordPath)
+{
+    FrameRecordReader reader;
+    if (!reader.Open(recordPath))
+    {
+        cout << "Failed to read record file." << endl;
+        cout << "Enter any key to go back to main menu." << endl;
+        GetKey();
+        return;
+    }
+
+    const FrameRecordInfo &info = reader.GetInfo();
+    config.configPath = info.configPath;
+    config.gameDifficulty = info.gameDifficulty;
+    map.mapPath = info.mapPath;
+    map.width = info.columns - 2;
+    map.height = info.rows - 2;
+    replay = true;
+    recordScreen = true;
+    gameOver = false;
+
+    // 分数直接从帧索引读取；定位时顺序播放只解码一个增量帧，其他情况从最近的关键帧开始解码
+    vector<int> scores(reader.GetFrameCount());
+    for (long long i = 0; i < reader.GetFrameCount(); ++i)
+    {
+        scores[i] = reader.GetScore(i);
+    }
+    ScrubReplay(scores, [this, &reader](long long i)
+                {
+                    if (!reader.Seek(i))
+                    {
+                        return false;
+                    }
+                    screen = reader.GetFrame();
+                    return true; });
+}
+
+void SnakeGame::ReplayEvents(istream &recordFile)
+{
+    GameRecord replayRecord;
+    if (!ReadGameRecord(recordFile, replayRecord))
+    {
+        cout << "Failed to read record file." << endl;
+        cout << "Enter any key to go back to main menu." << endl;
+        GetKey();
+        return;
+    }
+
+    // 用记录中的地图、配置和随机种子推演一遍，建立分数表和引擎快照
+    config = replayRecord.config;
+    map = replayRecord.map;
+    EventReplayIndex index;
+    index.Build(replayRecord);
+    replay = true;
+    recordScreen = false;
+    viewX = -1;
+    viewY = -1;
+
+    // 每一帧由引擎从最近的快照按记录的方向推进得到
+    ScrubReplay(index.GetScores(), [this, &index](long long i)
+                { return index.Seek(i, engine); });
+}
+
+void SnakeGame::ReplayFrames(istream &recordFile, const string &configPath)
+{
+    // 读取配置文件路径、地图文件路径、难度、地图大小、地图计数
+    int screenCount;
+    config.configPath = configPath;
     recordFile >> map.mapPath;
     recordFile >> config.gameDifficulty;
     recordFile >> map.height >> map.width;
     recordFile >> screenCount;
 
-    screen.clear();
-    screenRecord.resize(screenCount, vector<vector<char>>(map.height + 2, vector<char>(map.width + 2, '0')));
-    scoreRecord.clear();
-    scoreRecord.resize(screenCount);
+    screen.Assign(map.width + 2, map.height + 2, '0');
+    replay = true;
+    recordScreen = true;
+    gameOver = false;
 
-    for (int i = 0; i < screenCount; ++i)
+    // 旧版记录没有索引，全部读入内存后再回放，文件不完整时只回放完整的帧
+    size_t cells = screen.Size();
+    vector<char> frames;
+    vector<int> scores;
+    for (int i = 0; i < screenCount && recordFile; ++i)
     {
         for (int j = 0; j <= map.height + 1; ++j)
         {
             for (int k = 0; k <= map.width + 1; ++k)
             {
-                recordFile >> screenRecord[i][j][k];
+                recordFile >> screen.At(k, j);
             }
         }
-        recordFile >> scoreRecord[i];
+        int frameScore;
+        if (recordFile >> frameScore)
+        {
+            frames.insert(frames.end(), screen.Data(), screen.Data() + cells);
+            scores.push_back(frameScore);
+        }
     }
+    ScrubReplay(scores, [this, &frames, cells](long long i)
+                {
+                    memcpy(screen.Data(), frames.data() + i * cells, cells);
+                    return true; });
+}
 
-    recordFile.close();
-
-    replay = true;
-    gameOver = false;
+template <class Seek>
+void SnakeGame::ScrubReplay(const vector<int> &scores, Seek seek)
+{
+    long long last = static_cast<long long>(scores.size()) - 1;
+    if (last < 0)
+    {
+        cout << "Record file is empty." << endl;
+        cout << "Enter any key to go back to main menu." << endl;
+        GetKey();
+        return;
+    }
 
-    // 回放游戏
-    for (int i = 0; i < screenCount; ++i)
+    // 速度为正常速度的倍数，0 表示不等待，画完一帧立即播放下一帧
+    int speed = 1;
+    auto frameInterval = [this, &speed]() -> long long
+    { return speed == 0 ? 0 : 1000 / (config.gameDifficulty * speed); };
+    bool paused = false;
+    bool reverse = false;
+    long long frame = 0;
+    nextTick = MonotonicMs();
+    while (true)
     {
-        if (i == screenCount - 1)
+        if (!seek(frame))
         {
-            gameOver = true;
+            cout << "Record file is corrupted." << endl;
+            cout << "Enter any key to go back to main menu." << endl;
+            GetKey();
+            return;
         }
-        score = scoreRecord[i];
-        screen = screenRecord[i];
+        score = scores[frame];
+        gameOver = frame == last;
+
+        // 播放到头时停下，仍可以倒放、逐帧和跳转
+        bool playing = !paused && (reverse ? frame > 0 : frame < last);
+        replayStatus = "Tick " + to_string(frame) + "/" + to_string(last) + ", " +
+                       (speed == 0 ? string("max speed") : to_string(speed) + "x") + ", " +
+                       (!playing ? "paused" : reverse ? "reverse" : "playing");
         DrawMap();
 
-        DWORD endTime = GetTickCount64() + 1000 / config.gameDifficulty;
-        char key = 0;
+        // 播放时等到下一帧的时间点，期间的按键立即处理；暂停时休眠到有按键
+        int key;
+        if (playing)
+        {
+            key = WaitKey(max(0LL, nextTick - MonotonicMs()));
+            if (key == 0)
+            {
+                frame += reverse ? -1 : 1;
+                AdvanceTick(frameInterval());
+                continue;
+            }
+        }
+        else
+        {
+            key = GetKey();
+            nextTick = MonotonicMs();
+        }
 
-        while (GetTickCount64() < endTime)
+        switch (key)
         {
-            if (_kbhit())
+        case 'q':
+            return;
+        case ' ':
+            paused = !paused;
+            nextTick = MonotonicMs();
+            break;
+        case '1':
+        case '2':
+        case '8':
+        case '0':
+            // 加速时下一帧不再等待原来的步长
+            speed = key - '0';
+            nextTick = min(nextTick, MonotonicMs() + frameInterval());
+            break;
+        case 'r':
+            reverse = !reverse;
+            paused = false;
+            break;
+        case ',':
+            paused = true;
+            frame = max(0LL, frame - 1);
+            break;
+        case '.':
+            paused = true;
+            frame = min(last, frame + 1);
+            break;
+        case 'g':
+        {
+            long long tick = ReadReplayNumber("Go to tick (0-" + to_string(last) + "): ");
+            if (tick >= 0)
             {
-                key = _getch();
+                frame = min(tick, last);
+                paused = true;
             }
-            // 按q退出回放
-            if (key == 'q')
+            break;
+        }
+        case 's':
+        {
+            // 分数不会减少，跳到第一个达到该分数的帧，没有时跳到最后一帧
+            long long target = ReadReplayNumber("Go to score (0-" + to_string(scores[last]) + "): ");
+            if (target >= 0)
             {
-                return;
+                frame = min<long long>(lower_bound(scores.begin(), scores.end(), target) - scores.begin(), last);
+                paused = true;
             }
+            break;
+        }
         }
     }
-    char key = _getch();
+}
 
-    replay = false;
-    gameOver = false;
+long long SnakeGame::ReadReplayNumber(const string &prompt)
+{
+    string digits;
+    while (true)
+    {
+        replayStatus = prompt + digits;
+        DrawMap();
+        int key = GetKey();
+        if (key >= '0' && key <= '9' && digits.size() < 18)
+        {
+            digits += static_cast<char>(key);
+        }
+        else if ((key == 127 || key == 8) && !digits.empty())
+        {
+            digits.pop_back();
+        }
+        else if (key == '\r' || key == '\n')
+        {
+            return digits.empty() ? -1 : stoll(digits);
+        }
+        else if (key == 27 || key == 'q')
+        {
+            return -1;
+        }
+    }
+}
+
+void SnakeGame::AdvanceTick(long long interval)
+{
+    nextTick += interval;
+    // 处理输入或绘制耗时过长导致落后时，从当前时间重新计时，避免连续快进
+    long long now = MonotonicMs();
+    if (now - nextTick > interval)
+    {
+        nextTick = now;
+    }
 }
 
 void SnakeGame::CreateConfig()
@@ -872,7 +914,7 @@ void SnakeGame::CreateConfig()
     {
         cout << "Configuration file already exists." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
@@ -881,14 +923,14 @@ void SnakeGame::CreateConfig()
     {
         cout << "Failed to create configuration file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
     // 输入难度、随机种子、食物数量、食物概率
     cout << "Enter the game difficulty (1-10): ";
     cin >> config.gameDifficulty;
-    while (config.gameDifficulty < 1 || config.gameDifficulty > 10)
+    while (config.gameDifficulty < MIN_DIFFICULTY || config.gameDifficulty > MAX_DIFFICULTY)
     {
         cout << "Invalid game difficulty. Please enter a number between 1 and 10: ";
         cin >> config.gameDifficulty;
@@ -899,7 +941,7 @@ void SnakeGame::CreateConfig()
 
     cout << "Enter the number of food items (1-5): ";
     cin >> config.numOfFood;
-    while (config.numOfFood < 1 || config.numOfFood > 5)
+    while (config.numOfFood < MIN_NUM_OF_FOOD || config.numOfFood > MAX_NUM_OF_FOOD)
     {
         cout << "Invalid number of food items. Please enter a number between 1 and 5: ";
         cin >> config.numOfFood;
@@ -939,7 +981,7 @@ void SnakeGame::CreateConfig()
 
     cout << "Configuration created." << endl;
     cout << "Enter any key to go back to main menu." << endl;
-    char key = _getch();
+    GetKey();
 }
 
 void SnakeGame::LoadConfig()
@@ -967,32 +1009,21 @@ void SnakeGame::LoadConfig()
     }
 
     // 打开配置文件，如果文件不存在则提示错误，如果文件存在则加载配置文件
-    config.configPath = "config/" + configName + ".config";
-
-    ifstream configFile(config.configPath);
-    if (!configFile)
+    if (!configCache.Get("config/" + configName + ".config", config, ReadConfigFile))
     {
         cout << "Failed to load configuration file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
-    // 读取配置文件
-    configFile >> config.gameDifficulty;
-    configFile >> config.randomSeed;
-    configFile >> config.numOfFood;
-    configFile >> config.foodProb[0] >> config.foodProb[1] >> config.foodProb[2];
-
-    configFile.close();
-
     // 保存配置文件路径
     ofstream lastConfigFile("config/last.config");
     if (!lastConfigFile)
     {
         cout << "Failed to save configuration file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
@@ -1001,10 +1032,33 @@ void SnakeGame::LoadConfig()
 
     cout << "Configuration loaded." << endl;
     cout << "Enter any key to go back to main menu." << endl;
-    char key = _getch();
+    GetKey();
 }
 
 void SnakeGame::LoadLastConfig()
+{
+    // 上次使用的配置文件路径和配置都经过缓存，文件没有改动时只查询文件状态
+    // 只有读取失败时才检查文件夹和默认配置文件
+    if (!pathCache.Get("config/last.config", config.configPath, ReadPathFile))
+    {
+        PrepareConfigDirectory();
+        config.configPath = "config/default.config";
+        ofstream lastConfigFile("config/last.config");
+        lastConfigFile << config.configPath << endl;
+    }
+
+    // 打开配置文件，如果文件不存在则改用默认配置文件
+    if (!configCache.Get(config.configPath, config, ReadConfigFile))
+    {
+        PrepareConfigDirectory();
+        config.configPath = "config/default.config";
+        ofstream updateLastConfig("config/last.config");
+        updateLastConfig << config.configPath << endl;
+        configCache.Get(config.configPath, config, ReadConfigFile);
+    }
+}
+
+void SnakeGame::PrepareConfigDirectory()
 {
     // 打开config文件夹，如果不存在则创建文件夹
     filesystem::path dir = "config";
@@ -1020,38 +1074,6 @@ void SnakeGame::LoadLastConfig()
         ofstream defaultConfigFile(defaultConfigPath);
         defaultConfigFile << "1\n-1\n1\n0.6 0.3 0.1\n";
     }
-
-    // 检查last.config文件，如果不存在则创建文件，如果存在则读取配置文件路径
-    ifstream configFile("config/last.config");
-    if (!configFile)
-    {
-        config.configPath = "config/default.config";
-        ofstream lastConfigFile("config/last.config");
-        lastConfigFile << config.configPath << endl;
-    }
-    else
-    {
-        getline(configFile, config.configPath);
-        configFile.close();
-    }
-
-    // 打开配置文件，如果文件不存在则提示错误，如果文件存在则加载配置文件
-    ifstream lastConfigFile(config.configPath);
-    if (!lastConfigFile)
-    {
-        config.configPath = "config/default.config";
-        ofstream updateLastConfig("config/last.config");
-        updateLastConfig << config.configPath << endl;
-        lastConfigFile.open("config/default.config");
-    }
-
-    // 读取配置文件
-    lastConfigFile >> config.gameDifficulty;
-    lastConfigFile >> config.randomSeed;
-    lastConfigFile >> config.numOfFood;
-    lastConfigFile >> config.foodProb[0] >> config.foodProb[1] >> config.foodProb[2];
-
-    lastConfigFile.close();
 }
 
 void SnakeGame::CreateMap()
@@ -1072,7 +1094,7 @@ void SnakeGame::CreateMap()
     {
         cout << "Map file already exists." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
@@ -1081,25 +1103,25 @@ void SnakeGame::CreateMap()
     {
         cout << "Failed to create map file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
     // 设置新地图的大小
     Map newMap;
-    cout << "Enter the map map.width (8-20): ";
+    cout << "Enter the map map.width (" << MIN_MAP_SIZE << "-" << MAX_MAP_SIZE << "): ";
     cin >> newMap.width;
-    while (newMap.width < 8 || newMap.width > 20)
+    while (newMap.width < MIN_MAP_SIZE || newMap.width > MAX_MAP_SIZE)
     {
-        cout << "Invalid map map.width. Please enter a number between 8 and 20: ";
+        cout << "Invalid map map.width. Please enter a number between " << MIN_MAP_SIZE << " and " << MAX_MAP_SIZE << ": ";
         cin >> newMap.width;
     }
 
-    cout << "Enter the map map.height (8-20): ";
+    cout << "Enter the map map.height (" << MIN_MAP_SIZE << "-" << MAX_MAP_SIZE << "): ";
     cin >> newMap.height;
-    while (newMap.height < 8 || newMap.height > 20)
+    while (newMap.height < MIN_MAP_SIZE || newMap.height > MAX_MAP_SIZE)
     {
-        cout << "Invalid map map.height. Please enter a number between 8 and 20: ";
+        cout << "Invalid map map.height. Please enter a number between " << MIN_MAP_SIZE << " and " << MAX_MAP_SIZE << ": ";
         cin >> newMap.height;
     }
 
@@ -1116,19 +1138,29 @@ void SnakeGame::CreateMap()
     int x, y;
     bool found = false;
     bool finished = false;
-    screen.clear();
-    screen.resize(newMap.height + 2, vector<char>(newMap.width + 2, '0'));
+    // 障碍物分块保存，大地图也只占用与障碍物数量成正比的内存
+    ChunkedGrid<char> preview(newMap.width + 2, newMap.height + 2, '0');
+    // 终端放得下整个地图时才绘制预览
+    int columns = DEFAULT_TERMINAL_COLUMNS;
+    int rows = DEFAULT_TERMINAL_ROWS;
+    GetTerminalSize(columns, rows);
+    bool showPreview = newMap.width + 2 <= columns && newMap.height + 2 <= rows;
 
     // 设置障碍物和边界属性
     while (!finished)
     {
-        system("cls");
+        ClearScreen();
+        if (!showPreview)
+        {
+            cout << "The map is " << newMap.width << "x" << newMap.height << " with " << newMap.numOfObstacle
+                 << " obstacles, too large to preview." << endl;
+        }
         // 绘制画面，根据不同的字符，输出不同的字符和颜色
-        for (int i = 0; i <= newMap.height + 1; ++i)
+        for (int i = 0; showPreview && i <= newMap.height + 1; ++i)
         {
             for (int j = 0; j <= newMap.width + 1; ++j)
             {
-                if (screen[i][j] == 'O')
+                if (preview.At(j, i) == 'O')
                 {
                     cout << "\033[44mO\033[0m";
                 }
@@ -1206,7 +1238,7 @@ void SnakeGame::CreateMap()
                 cin >> x >> y;
             }
             newMap.obstacle.push_back({x, y});
-            screen[y + 1][x + 1] = 'O';
+            preview.Set(x + 1, y + 1, 'O');
             break;
         case 'p':
             cin >> x >> y;
@@ -1221,7 +1253,7 @@ void SnakeGame::CreateMap()
                 {
                     newMap.obstacle.erase(newMap.obstacle.begin() + i);
                     newMap.numOfObstacle--;
-                    screen[y + 1][x + 1] = '0';
+                    preview.Set(x + 1, y + 1, '0');
                     found = true;
                     break;
                 }
@@ -1287,7 +1319,7 @@ void SnakeGame::CreateMap()
     {
         for (int i = 0; i < newMap.numOfObstacle; ++i)
         {
-            newMapFile << newMap.obstacle[i].x << " " << newMap.obstacle[i].y << endl;
+            newMapFile << newMap.obstacle[i].x << " " << newMap.obstacle[i].y << '\n';
         }
     }
 
@@ -1295,7 +1327,7 @@ void SnakeGame::CreateMap()
 
     cout << "Map created." << endl;
     cout << "Enter any key to go back to main menu." << endl;
-    char key = _getch();
+    GetKey();
 }
 
 void SnakeGame::LoadMap()
@@ -1322,44 +1354,22 @@ void SnakeGame::LoadMap()
         return;
     }
 
-    map.mapPath = "map/" + mapName + ".map";
-
     // 打开地图文件，如果文件不存在则提示错误，如果文件存在则加载地图文件
-    ifstream mapFile(map.mapPath);
-    if (!mapFile)
+    if (!mapCache.Get("map/" + mapName + ".map", map, LoadMapFile))
     {
         cout << "Failed to load map file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
-    map.numOfObstacle = 0;
-    map.obstacle.clear();
-
-    // 读取地图文件
-    mapFile >> map.width >> map.height;
-    mapFile >> map.real[UP] >> map.real[DOWN] >> map.real[LEFT] >> map.real[RIGHT];
-    mapFile >> map.numOfObstacle;
-    if (map.numOfObstacle > 0)
-    {
-        for (int i = 0; i < map.numOfObstacle; ++i)
-        {
-            int x, y;
-            mapFile >> x >> y;
-            map.obstacle.push_back({x, y});
-        }
-    }
-
-    mapFile.close();
-
     // 保存地图文件路径
     ofstream lastMapFile("map/last.map");
     if (!lastMapFile)
     {
         cout << "Failed to save map file." << endl;
         cout << "Enter any key to go back to main menu." << endl;
-        char key = _getch();
+        GetKey();
         return;
     }
 
@@ -1368,105 +1378,70 @@ void SnakeGame::LoadMap()
 
     cout << "Map loaded." << endl;
     cout << "Enter any key to go back to main menu." << endl;
-    char key = _getch();
+    GetKey();
 }
 
 void SnakeGame::LoadLastMap()
 {
-    // 打开map文件夹，如果不存在则创建文件夹
-    filesystem::path dir = "map";
-    if (!filesystem::exists(dir))
-    {
-        filesystem::create_directories(dir);
-    }
-
-    // 检查default.map文件，如果不存在则创建文件
-    filesystem::path defaultMapPath = "map/default.map";
-    if (!filesystem::exists(defaultMapPath))
-    {
-        ofstream defaultMapFile(defaultMapPath);
-        defaultMapFile << "15 15\n1 1 1 1\n0\n";
-    }
-
-    // 检查last.map文件，如果不存在则创建文件，如果存在则读取地图文件路径
-    ifstream mapFile("map/last.map");
-    if (!mapFile)
+    // 上次使用的地图文件路径和地图都经过缓存，文件没有改动时只查询文件状态
+    // 只有读取失败时才检查文件夹和默认地图文件
+    if (!pathCache.Get("map/last.map", map.mapPath, ReadPathFile))
     {
+        PrepareMapDirectory();
         map.mapPath = "map/default.map";
         ofstream lastMapFile("map/last.map");
         lastMapFile << map.mapPath << endl;
     }
-    else
-    {
-        getline(mapFile, map.mapPath);
-        mapFile.close();
-    }
 
-    // 打开地图文件，如果文件不存在则提示错误，如果文件存在则加载地图文件
-    ifstream lastMapFile(map.mapPath);
-    if (!lastMapFile)
+    // 打开地图文件，如果文件不存在则改用默认地图文件
+    if (!mapCache.Get(map.mapPath, map, LoadMapFile))
     {
+        PrepareMapDirectory();
         map.mapPath = "map/default.map";
         ofstream updateLastMap("map/last.map");
         updateLastMap << map.mapPath << endl;
-        lastMapFile.open("map/default.map");
+        mapCache.Get(map.mapPath, map, LoadMapFile);
     }
-
-    map.numOfObstacle = 0;
-    map.obstacle.clear();
-
-    // 读取地图文件
-    lastMapFile >> map.width >> map.height;
-    lastMapFile >> map.real[UP] >> map.real[DOWN] >> map.real[LEFT] >> map.real[RIGHT];
-    lastMapFile >> map.numOfObstacle;
-
-    if (map.numOfObstacle > 0)
-    {
-        for (int i = 0; i < map.numOfObstacle; ++i)
-        {
-            int x, y;
-            lastMapFile >> x >> y;
-            map.obstacle.push_back({x, y});
-        }
-    }
-
-    lastMapFile.close();
 }
 
-void SnakeGame::UpdateLeaderboard()
+void SnakeGame::PrepareMapDirectory()
 {
-    // 打开leaderboard文件夹，如果不存在则创建文件夹
-    filesystem::path dir = "leaderboard";
+    // 打开map文件夹，如果不存在则创建文件夹
+    filesystem::path dir = "map";
     if (!filesystem::exists(dir))
     {
         filesystem::create_directories(dir);
     }
 
-    // 检查leaderboard文件，如果不存在则创建文件
-    filesystem::path leaderboardPath = "leaderboard/leaderboard.txt";
-    if (!filesystem::exists(leaderboardPath))
+    // 检查default.map文件，如果不存在则创建文件
+    filesystem::path defaultMapPath = "map/default.map";
+    if (!filesystem::exists(defaultMapPath))
+    {
+        ofstream defaultMapFile(defaultMapPath);
+        defaultMapFile << "15 15\n1 1 1 1\n0\n";
+    }
+}
+
+bool SnakeGame::OpenLeaderboard()
+{
+    // 打开排行榜要读入整个索引，只在第一次使用时打开，不存在时创建，只有旧版文本排行榜时导入
+    bool ok = leaderboardOpened ? leaderboard.Refresh() : leaderboard.Open();
+    // 失败时内存中的索引可能不完整，下次重新打开
+    leaderboardOpened = ok;
+    if (!ok)
     {
-        ofstream leaderboardFile(leaderboardPath);
-        leaderboardFile << "Name Score Date Time Configuration Map\n";
+        cout << "Error: Failed to open leaderboard. " << leaderboard.GetError() << endl;
     }
+    return ok;
+}
 
-    // 读取leaderboard文件
-    ifstream leaderboardFile(leaderboardPath);
-    string line;
-    leaderboard.clear();
-    while (getline(leaderboardFile, line))
+void SnakeGame::UpdateLeaderboard()
+{
+    if (!OpenLeaderboard())
     {
-        if (line == "Name Score Date Time Configuration Map")
-        {
-            continue;
-        }
-        std::stringstream ss(line);
-        LeaderboardEntry entry;
-        ss >> entry.name >> entry.score >> entry.date >> entry.time >> entry.configPath >> entry.mapPath;
-        leaderboard.push_back(entry);
+        return;
     }
-    leaderboardFile.close();
-    
+
     // 获取玩家姓名
     string name;
     cout << "Enter your name: ";
@@ -1479,7 +1454,7 @@ void SnakeGame::UpdateLeaderboard()
     string date = to_string(1900 + ltm->tm_year) + "/" + to_string(1 + ltm->tm_mon) + "/" + to_string(ltm->tm_mday);
     string time = to_string(ltm->tm_hour) + ":" + to_string(ltm->tm_min) + ":" + to_string(ltm->tm_sec);
 
-    // 添加新记录
+    // 添加新记录，只追加到日志和索引末尾
     LeaderboardEntry newEntry;
     newEntry.name = playerName;
     newEntry.score = score;
@@ -1487,64 +1462,56 @@ void SnakeGame::UpdateLeaderboard()
     newEntry.time = time;
     newEntry.configPath = config.configPath;
     newEntry.mapPath = map.mapPath;
-    leaderboard.push_back(newEntry);
-
-    // 排序
-    sort(leaderboard.begin(), leaderboard.end(), [](const LeaderboardEntry &a, const LeaderboardEntry &b)
-         { return a.score > b.score; });
-
-    // 保存leaderboard文件
-    ofstream newLeaderboardFile(leaderboardPath);
-    newLeaderboardFile << "Name Score Date Time Configuration Map\n";
-    for (int i = 0; i < leaderboard.size(); ++i)
+    if (!leaderboard.Add(newEntry))
     {
-        newLeaderboardFile << leaderboard[i].name << " " << leaderboard[i].score << " " << leaderboard[i].date << " " << leaderboard[i].time << " " << leaderboard[i].configPath << " " << leaderboard[i].mapPath << endl;
+        leaderboardOpened = false;
+        cout << "Error: Failed to update leaderboard. " << leaderboard.GetError() << endl;
+        return;
     }
-    newLeaderboardFile.close();
 
-    cout << "Leaderboard updated." << endl;
+    cout << "Leaderboard updated. Your rank: " << leaderboard.Rank(score) << " of " << leaderboard.Size() << "." << endl;
 }
 
 void SnakeGame::DisplayLeaderboard()
 {
-    // 打开leaderboard文件夹，如果不存在则创建文件夹
-    filesystem::path dir = "leaderboard";
-    if (!filesystem::exists(dir))
+    if (!OpenLeaderboard())
     {
-        filesystem::create_directories(dir);
+        return;
     }
 
-    // 检查leaderboard文件，如果不存在则创建文件
-    filesystem::path leaderboardPath = "leaderboard/leaderboard.txt";
-    if (!filesystem::exists(leaderboardPath))
+    // 输入筛选条件，- 表示不限
+    LeaderboardFilter filter;
+    string path;
+    cout << "Enter the map to show (- for all maps): ";
+    cin >> path;
+    if (path != "-")
     {
-        ofstream leaderboardFile(leaderboardPath);
-        leaderboardFile << "Name Score Date Time Configuration Map\n";
+        filter.mapPath = path;
     }
-
-    // 读取leaderboard文件
-    ifstream leaderboardFile(leaderboardPath);
-    string line;
-    leaderboard.clear();
-    while (getline(leaderboardFile, line))
+    cout << "Enter the configuration to show (- for all configurations): ";
+    cin >> path;
+    if (path != "-")
     {
-        if (line == "Name Score Date Time Configuration Map")
-        {
-            continue;
-        }
-        std::stringstream ss(line);
-        LeaderboardEntry entry;
-        ss >> entry.name >> entry.score >> entry.date >> entry.time >> entry.configPath >> entry.mapPath;
-        leaderboard.push_back(entry);
+        filter.configPath = path;
+    }
+    int days;
+    cout << "Enter the number of days to show (0 for all time, 7 for the past week): ";
+    cin >> days;
+    while (days < 0)
+    {
+        cout << "Invalid number of days. Please enter a number not less than 0: ";
+        cin >> days;
+    }
+    if (days > 0)
+    {
+        filter.dateFrom = DateDaysAgo(days - 1);
     }
-    leaderboardFile.close();
 
-    // 排序
-    sort(leaderboard.begin(), leaderboard.end(), [](const LeaderboardEntry &a, const LeaderboardEntry &b)
-         { return a.score > b.score; });
+    // 只读取满足条件的前几名的记录
+    vector<LeaderboardEntry> entries = leaderboard.Top(LEADERBOARD_DISPLAY_COUNT, filter);
 
     // 输出leaderboard
-    system("cls");
+    ClearScreen();
 
     cout << left << setw(5) << "Rank"
          << setw(20) << "Name"
@@ -1554,33 +1521,59 @@ void SnakeGame::DisplayLeaderboard()
          << setw(30) << "Configuration"
          << setw(30) << "Map" << endl;
 
-    for (int i = 0; i < leaderboard.size(); ++i)
+    for (size_t i = 0; i < entries.size(); ++i)
     {
         cout << left << setw(5) << i + 1
-             << setw(20) << leaderboard[i].name
-             << setw(10) << leaderboard[i].score
-             << setw(15) << leaderboard[i].date
-             << setw(10) << leaderboard[i].time
-             << setw(30) << leaderboard[i].configPath
-             << setw(30) << leaderboard[i].mapPath << endl;
+             << setw(20) << entries[i].name
+             << setw(10) << entries[i].score
+             << setw(15) << entries[i].date
+             << setw(10) << entries[i].time
+             << setw(30) << entries[i].configPath
+             << setw(30) << entries[i].mapPath << endl;
+    }
+    cout << "Top " << entries.size() << " of " << leaderboard.Size() << " entries";
+    if (!filter.mapPath.empty())
+    {
+        cout << " on " << filter.mapPath;
+    }
+    if (!filter.configPath.empty())
+    {
+        cout << " with " << filter.configPath;
+    }
+    if (days > 0)
+    {
+        cout << " in the last " << days << " days";
     }
+    cout << "." << endl;
     cout << "Enter any key to go back to main menu." << endl;
-    char key = _getch();
+    GetKey();
 }
 
 // 主函数
-int main()
+int main(int argc, char *argv[])
 {
+    EnableVirtualTerminal();
+
     SnakeGame snakeGame;
     snakeGame.Init();
+    // --metrics 开启每格耗时统计，每局结束时输出摘要并写入 metrics 文件夹
+    for (int i = 1; i < argc; ++i)
+    {
+        if (string(argv[i]) == "--metrics")
+        {
+            snakeGame.EnableMetrics();
+        }
+    }
 
     char choice;
     do
     {
-        system("cls");
+        ClearScreen();
         cout << "Snake - Fundamentals of Programming" << endl;
         cout << "-----------------------------------" << endl;
         cout << "g: Start Game" << endl;
+        cout << "a: Autopilot Demo" << endl;
+        cout << "c: Computer Player (MCTS)" << endl;
         cout << "q: Quit Game" << endl;
         cout << "i: Create Configuration" << endl;
         cout << "u: Load Configuration" << endl;
@@ -1597,6 +1590,12 @@ int main()
         case 'g':
             snakeGame.Run();
             break;
+        case 'a':
+            snakeGame.Run(AUTOPILOT);
+            break;
+        case 'c':
+            snakeGame.Run(COMPUTER);
+            break;
         case 'q':
             cout << "Goodbye!" << endl;
             break;
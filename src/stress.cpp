@@ -0,0 +1,168 @@
+/*Snake Game - Leaderboard Stress Test
+2023.12
+排行榜并发写入测试：启动多个写入进程同时向同一个排行榜追加记录，全部结束后检查每条记录都在且只出现一次
+用法：stress [writers] [entries per writer] [directory]
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
+
+#include "leaderboard.h"
+
+using namespace std;
+
+#ifndef _WIN32
+extern char **environ;
+#endif
+
+// 写入进程：逐条追加 count 条记录，名字为 w<writer>-<i>，分数各不相同
+int RunWriter(const string &directory, int writer, int count)
+{
+    Leaderboard leaderboard;
+    if (!leaderboard.Open(directory))
+    {
+        cout << "Error: " << leaderboard.GetError() << endl;
+        return 1;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        LeaderboardEntry entry;
+        entry.name = "w" + to_string(writer) + "-" + to_string(i);
+        entry.score = writer * count + i;
+        entry.date = "2023/12/1";
+        entry.time = "0:0:0";
+        entry.configPath = "config/default.config";
+        entry.mapPath = "map/default.map";
+        if (!leaderboard.Add(entry))
+        {
+            cout << "Writer " << writer << " failed at entry " << i << "." << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 启动 writers 个写入进程并等待全部结束，返回失败的进程数
+int RunWriters(const string &program, const string &directory, int writers, int count)
+{
+    int failed = 0;
+#ifdef _WIN32
+    vector<intptr_t> children;
+    for (int writer = 0; writer < writers; ++writer)
+    {
+        string writerText = to_string(writer);
+        string countText = to_string(count);
+        const char *args[] = {program.c_str(), "--writer", directory.c_str(), writerText.c_str(), countText.c_str(), nullptr};
+        intptr_t child = _spawnv(_P_NOWAIT, program.c_str(), args);
+        if (child == -1)
+        {
+            ++failed;
+            continue;
+        }
+        children.push_back(child);
+    }
+    for (intptr_t child : children)
+    {
+        int status = 0;
+        if (_cwait(&status, child, 0) == -1 || status != 0)
+        {
+            ++failed;
+        }
+    }
+#else
+    vector<pid_t> children;
+    for (int writer = 0; writer < writers; ++writer)
+    {
+        string writerText = to_string(writer);
+        string countText = to_string(count);
+        char *args[] = {const_cast<char *>(program.c_str()), const_cast<char *>("--writer"),
+                        const_cast<char *>(directory.c_str()), const_cast<char *>(writerText.c_str()),
+                        const_cast<char *>(countText.c_str()), nullptr};
+        pid_t child;
+        if (posix_spawn(&child, program.c_str(), nullptr, nullptr, args, environ) != 0)
+        {
+            ++failed;
+            continue;
+        }
+        children.push_back(child);
+    }
+    for (pid_t child : children)
+    {
+        int status = 0;
+        if (waitpid(child, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ++failed;
+        }
+    }
+#endif
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 5 && string(argv[1]) == "--writer")
+    {
+        return RunWriter(argv[2], stoi(argv[3]), stoi(argv[4]));
+    }
+
+    int writers = argc > 1 ? stoi(argv[1]) : 16;
+    int count = argc > 2 ? stoi(argv[2]) : 1000;
+    string directory = argc > 3 ? argv[3] : "stress-leaderboard";
+    if (filesystem::exists(directory))
+    {
+        cout << "Error: " << directory << " already exists." << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    int failed = RunWriters(argv[0], directory, writers, count);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // 检查：总数正确，每个写入进程的每条记录恰好出现一次，名次与分数一致
+    Leaderboard leaderboard;
+    if (!leaderboard.Open(directory))
+    {
+        cout << "Error: " << leaderboard.GetError() << endl;
+        return 1;
+    }
+    long long expected = (long long)writers * count;
+    vector<LeaderboardEntry> entries = leaderboard.Top(leaderboard.Size());
+    vector<char> seen(expected, 0);
+    long long bad = 0;
+    for (const LeaderboardEntry &entry : entries)
+    {
+        string name = "w" + to_string(entry.score / count) + "-" + to_string(entry.score % count);
+        if (entry.score < 0 || entry.score >= expected || entry.name != name || seen[entry.score]++)
+        {
+            ++bad;
+        }
+    }
+    long long lost = 0;
+    for (char flag : seen)
+    {
+        lost += flag == 0;
+    }
+    for (int rank = 1; rank <= (int)entries.size() && rank <= 100; ++rank)
+    {
+        bad += leaderboard.Rank(entries[rank - 1].score) != rank;
+    }
+
+    cout << "Writers: " << writers << ", entries per writer: " << count << endl;
+    cout << "Entries: " << entries.size() << " of " << expected << ", lost " << lost << ", bad " << bad << endl;
+    cout << "Failed writers: " << failed << endl;
+    cout << "Elapsed: " << seconds << " s, " << (long long)(expected / seconds) << " adds/s" << endl;
+    filesystem::remove_all(directory);
+    bool passed = failed == 0 && lost == 0 && bad == 0 && (long long)entries.size() == expected;
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/*Snake Game - Thread Pool
+2023.12
+工作窃取线程池：每个线程有自己的任务队列，从自己队列的尾部取任务，自己的队列空了再从其他线程队列的头部窃取
+*/
+
+#ifndef SNAKE_THREADPOOL_H
+#define SNAKE_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 空闲线程找不到任务时先让出 CPU 的次数，之后休眠到有新任务或全部任务完成
+const int THREAD_POOL_IDLE_SPINS = 64;
+
+// 工作窃取线程池，任务的参数为执行它的线程编号，可用来访问每个线程独占的数据
+class WorkStealingPool
+{
+private:
+    typedef function<void(int)> Task;
+
+    // 每个线程一个任务队列，队列很少发生竞争，用互斥锁保护即可
+    struct Queue
+    {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    // 尚未完成的任务数，所有任务完成后线程退出
+    atomic<long long> pending;
+    // 还在队列中、没有被取走的任务数，空闲线程据此判断是否值得醒来
+    atomic<long long> queued;
+    // 下一个任务放入的队列
+    int nextQueue;
+    // 空闲线程在这里休眠，只用于等待，队列本身由各自的锁保护
+    mutex idleLock;
+    condition_variable idle;
+
+    // 加锁再通知，保证空闲线程检查条件和开始等待之间不会漏掉通知
+    void WakeIdle(bool all)
+    {
+        {
+            lock_guard<mutex> guard(idleLock);
+        }
+        if (all)
+        {
+            idle.notify_all();
+        }
+        else
+        {
+            idle.notify_one();
+        }
+    }
+
+    // 从自己队列的尾部取任务，最近放入的任务数据更可能还在缓存中
+    bool PopLocal(int worker, Task &task)
+    {
+        Queue &queue = *queues[worker];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+        task = move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --queued;
+        return true;
+    }
+
+    // 从其他线程队列的头部窃取任务，与队列主人从两端取，减少冲突
+    bool Steal(int worker, Task &task)
+    {
+        int count = queues.size();
+        for (int i = 1; i < count; ++i)
+        {
+            Queue &queue = *queues[(worker + i) % count];
+            lock_guard<mutex> guard(queue.lock);
+            if (!queue.tasks.empty())
+            {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+                --queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerLoop(int worker)
+    {
+        Task task;
+        int spins = 0;
+        while (pending.load() > 0)
+        {
+            if (PopLocal(worker, task) || Steal(worker, task))
+            {
+                task(worker);
+                // 最后一个任务完成时唤醒所有空闲线程退出
+                if (--pending == 0)
+                {
+                    WakeIdle(true);
+                }
+                spins = 0;
+            }
+            else if (++spins < THREAD_POOL_IDLE_SPINS)
+            {
+                this_thread::yield();
+            }
+            else
+            {
+                // 剩下的任务都在其他线程手上执行，休眠到有任务可以窃取或全部完成，不占用 CPU
+                unique_lock<mutex> guard(idleLock);
+                idle.wait(guard, [this]
+                          { return pending.load() == 0 || queued.load() > 0; });
+                spins = 0;
+            }
+        }
+    }
+
+public:
+    // threads 为线程数，不大于 0 时使用硬件线程数
+    explicit WorkStealingPool(int threads = 0) : pending(0), queued(0), nextQueue(0)
+    {
+        if (threads <= 0)
+        {
+            threads = thread::hardware_concurrency();
+        }
+        if (threads <= 0)
+        {
+            threads = 1;
+        }
+        for (int i = 0; i < threads; ++i)
+        {
+            queues.emplace_back(new Queue());
+        }
+    }
+
+    int GetThreadCount() const { return queues.size(); }
+
+    // 提交任务，轮流放入各线程的队列，只能在 Run 之前调用
+    void Submit(Task task)
+    {
+        ++pending;
+        ++queued;
+        int index = nextQueue;
+        nextQueue = (nextQueue + 1) % queues.size();
+        Queue &queue = *queues[index];
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(move(task));
+    }
+
+    // 在任务中继续拆分工作，子任务放入当前线程自己的队列，空闲线程会来窃取
+    void SubmitLocal(int worker, Task task)
+    {
+        ++pending;
+        {
+            Queue &queue = *queues[worker];
+            lock_guard<mutex> guard(queue.lock);
+            queue.tasks.push_back(move(task));
+            ++queued;
+        }
+        WakeIdle(false);
+    }
+
+    // 启动所有线程执行任务，全部完成后返回；调用线程作为 0 号线程参与执行
+    void Run()
+    {
+        vector<thread> workers;
+        for (int i = 1; i < (int)queues.size(); ++i)
+        {
+            workers.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+        }
+        WorkerLoop(0);
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+};
+
+#endif